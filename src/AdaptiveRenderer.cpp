@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "AdaptiveRenderer.h"
+#include "Parallel.h"
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+
+const float DARK_LUMINANCE = 0.1; // Errors of darker pixels are measured relative to this
+
+
+/**
+* Adds one colour estimate to the running statistics of a pixel.
+*/
+void AdaptiveRenderer::addSample(PixelStats& px, glm::vec3 col)
+{
+	px.count++;
+	px.mean += (col - px.mean) / (float)px.count;
+	float lum = 0.2126f * col.r + 0.7152f * col.g + 0.0722f * col.b;
+	float delta = lum - px.lumMean;
+	px.lumMean += delta / px.count;
+	px.lumM2 += delta * (lum - px.lumMean);
+}
+
+/**
+* Standard error of the mean luminance of a pixel, relative to that luminance.
+*/
+float AdaptiveRenderer::error(const PixelStats& px)
+{
+	if (px.count < 2) return 1.e30;
+	float variance = px.lumM2 / (px.count - 1);
+	return sqrtf(variance / px.count) / std::max(px.lumMean, DARK_LUMINANCE);
+}
+
+/**
+* Renders the scene into 'frame' (row major, starting from the bottom left pixel),
+* taking every sample from 'sample'. Tiles are shared between threads.
+*/
+void AdaptiveRenderer::render(std::vector<glm::vec3>& frame, const SampleFunction& sample)
+{
+	auto start = std::chrono::steady_clock::now();
+	auto outOfTime = [&]() {
+		return timeBudget > 0 && std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() > timeBudget;
+	};
+
+	int n = camera.getNumDiv();
+	int maxSamples = samplesPerPixel * MAX_SAMPLES_SCALE;
+	int minSamples = std::min(std::max(samplesPerPixel / 2, 2), 16);
+	long long budget = (long long)samplesPerPixel * n * n;
+	accum.assign(n * n, PixelStats());
+
+	// First pass: one sample everywhere, then enough for a variance estimate while time allows
+	parallelFor(n, [&](int j) {
+		int samples = outOfTime() ? 1 : minSamples;
+		for (int i = 0; i < n; i++)
+		{
+			PixelStats& px = accum[j * n + i];
+			for (int s = 0; s < samples; s++) addSample(px, sample(i, j, px.count, maxSamples));
+		}
+	});
+	totalSamples = 0;
+	for (const PixelStats& px : accum) totalSamples += px.count;
+	passes = 1;
+
+	int tilesX = (n + TILE_SIZE - 1) / TILE_SIZE;
+	int numTiles = tilesX * tilesX;
+	std::vector<float> tileError(numTiles);
+	std::vector<int> tileActive(numTiles);
+	std::vector<int> tileSamples(numTiles); // Samples per active pixel in the next pass
+
+	while (totalSamples < budget && !outOfTime())
+	{
+		// Stop the converged pixels and sum the squared error left in each tile
+		std::fill(tileError.begin(), tileError.end(), 0.0f);
+		std::fill(tileActive.begin(), tileActive.end(), 0);
+		double errorSum = 0;
+		long long active = 0;
+		for (int p = 0; p < n * n; p++)
+		{
+			PixelStats& px = accum[p];
+			if (px.converged) continue;
+			float e = error(px);
+			if (e < threshold || px.count >= maxSamples) {
+				px.converged = true;
+				continue;
+			}
+			int t = (p / n / TILE_SIZE) * tilesX + (p % n) / TILE_SIZE;
+			tileError[t] += e * e;
+			tileActive[t]++;
+			errorSum += e * e;
+			active++;
+		}
+		if (active == 0) break;
+
+		// Share this pass's samples between the tiles in proportion to their error. The
+		// shares are counted in samples, whole samples per active pixel are given out,
+		// and what rounding leaves goes to the tiles with the most error, one sample per
+		// active pixel at a time. So every pass adds samples, even near the end of the
+		// budget where the shares are smaller than one sample per pixel.
+		long long remaining = budget - totalSamples;
+		long long passBudget = std::min(remaining, std::max(active, remaining / 4));
+		long long leftover = passBudget;
+		std::vector<int> order;
+		for (int t = 0; t < numTiles; t++)
+		{
+			tileSamples[t] = 0;
+			if (tileActive[t] == 0) continue;
+			double share = passBudget * (tileError[t] / errorSum);
+			tileSamples[t] = (int)std::min((double)maxSamples, share / tileActive[t]);
+			leftover -= (long long)tileSamples[t] * tileActive[t];
+			order.push_back(t);
+		}
+		std::sort(order.begin(), order.end(), [&](int a, int b) { return tileError[a] > tileError[b]; });
+		for (size_t k = 0; k < order.size() && leftover > 0; k++)
+		{
+			int t = order[k];
+			if (tileSamples[t] >= maxSamples) continue;
+			tileSamples[t]++; // The last tile served may overshoot by less than its active pixels
+			leftover -= tileActive[t];
+		}
+
+		parallelFor(numTiles, [&](int t) {
+			if (tileSamples[t] == 0 || outOfTime()) return;
+			int x0 = (t % tilesX) * TILE_SIZE, y0 = (t / tilesX) * TILE_SIZE;
+			for (int j = y0; j < std::min(y0 + TILE_SIZE, n); j++)
+			{
+				for (int i = x0; i < std::min(x0 + TILE_SIZE, n); i++)
+				{
+					PixelStats& px = accum[j * n + i];
+					if (px.converged) continue;
+					int k = std::min(tileSamples[t], maxSamples - px.count);
+					for (int s = 0; s < k; s++) addSample(px, sample(i, j, px.count, maxSamples));
+				}
+			}
+		});
+
+		long long previous = totalSamples;
+		totalSamples = 0;
+		for (const PixelStats& px : accum) totalSamples += px.count;
+		passes++;
+		if (totalSamples == previous) break; // Nothing left to sample, or out of time
+	}
+
+	frame.resize(n * n);
+	convergedPixels = 0;
+	for (int p = 0; p < n * n; p++)
+	{
+		frame[p] = accum[p].mean;
+		if (error(accum[p]) < threshold) convergedPixels++;
+	}
+}
+
+void AdaptiveRenderer::setThreshold(float noise)
+{
+	threshold = std::max(noise, 1.e-4f);
+}
+
+void AdaptiveRenderer::setTimeBudget(float ms)
+{
+	timeBudget = std::max(ms, 0.0f);
+}
+
+void AdaptiveRenderer::setSamples(int spp)
+{
+	samplesPerPixel = std::max(1, spp);
+}
+
+long long AdaptiveRenderer::getTotalSamples()
+{
+	return totalSamples;
+}
+
+int AdaptiveRenderer::getPasses()
+{
+	return passes;
+}
+
+int AdaptiveRenderer::getConvergedPixels()
+{
+	return convergedPixels;
+}
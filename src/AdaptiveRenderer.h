@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#ifndef H_ADAPTIVE
+#define H_ADAPTIVE
+#include <glm/glm.hpp>
+#include <vector>
+#include <functional>
+#include "Camera.h"
+
+/**
+ * Spends the samples of a stochastic renderer where the image is still noisy.
+ * The accumulation buffer keeps the running mean colour of every pixel and the
+ * running mean and variance of its luminance (Welford's update). After a first
+ * pass with a few samples everywhere, passes are repeated over 16x16 pixel tiles:
+ * pixels whose relative standard error is below the noise threshold stop, and
+ * each pass shares its samples between the tiles in proportion to the squared
+ * error left in them. Rendering ends when every pixel has converged, when the
+ * sample budget (average samples per pixel times the pixel count) is spent or
+ * when the time budget runs out.
+ */
+class AdaptiveRenderer
+{
+
+public:
+	/**
+	 * Returns one estimate of the colour of cell (i, j); 'index' counts the samples
+	 * of the cell and 'count' is the most it will get.
+	 */
+	typedef std::function<glm::vec3(int i, int j, int index, int count)> SampleFunction;
+
+private:
+	struct PixelStats
+	{
+		glm::vec3 mean = glm::vec3(0);
+		float lumMean = 0;
+		float lumM2 = 0; // Sum of squared luminance deviations
+		int count = 0;
+		bool converged = false;
+	};
+
+	static const int TILE_SIZE = 16;
+	static const int MAX_SAMPLES_SCALE = 16; // Most samples of a pixel, as a multiple of the average
+
+	Camera& camera;
+	std::vector<PixelStats> accum;
+	float threshold = 0.02;
+	float timeBudget = 0; // Milliseconds, 0 = unlimited
+	int samplesPerPixel = 16; // Average over the image
+
+	// Statistics of the last render
+	long long totalSamples = 0;
+	int passes = 0;
+	int convergedPixels = 0;
+
+	void addSample(PixelStats& px, glm::vec3 col);
+	float error(const PixelStats& px);
+
+public:
+	AdaptiveRenderer(Camera& c) : camera(c) {}
+
+	void render(std::vector<glm::vec3>& frame, const SampleFunction& sample);
+
+	void setThreshold(float noise);
+
+	void setTimeBudget(float ms);
+
+	void setSamples(int spp);
+
+	long long getTotalSamples();
+
+	int getPasses();
+
+	int getConvergedPixels();
+
+};
+
+#endif //!H_ADAPTIVE
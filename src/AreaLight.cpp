@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "AreaLight.h"
+#include <math.h>
+#include <glm/gtc/constants.hpp>
+
+float AreaLight::visibleArea()
+{
+	return area();
+}
+
+bool AreaLight::isTwoSided()
+{
+	return true;
+}
+
+/**
+* Radiance emitted from the point 'x' on the light towards the point 'p'.
+* Lights in this renderer do not fall off with distance, so the radiance is
+* normalised such that integrating it over the light, as seen from 'p', gives
+* the same illumination as illuminate() does for the Whitted tracer.
+*/
+glm::vec3 AreaLight::emitted(glm::vec3 p, glm::vec3 x)
+{
+	glm::vec3 d = p - x;
+	float dist2 = glm::dot(d, d);
+	float dist = sqrt(dist2);
+	float cosLight = fabs(glm::dot(surfaceNormal(x), d)) / dist;
+	if (cosLight < 1.e-4) return glm::vec3(0);
+	return glm::pi<float>() * intensity_ * attenuation(dist) * color_ * dist2 / (visibleArea() * cosLight);
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#ifndef H_AREALIGHT
+#define H_AREALIGHT
+#include <glm/glm.hpp>
+#include "PointLight.h"
+
+/**
+ * Base class of lights with a surface. Shading treats the light as a point
+ * light at its center, while shadow rays are cast towards points sampled
+ * on its surface to produce soft shadows.
+ */
+class AreaLight : public PointLight
+{
+
+public:
+	AreaLight() {};
+
+	AreaLight(glm::vec3 c) : PointLight(c) {}
+
+	/**
+	 * Maps the unit square coordinates (u, v) uniformly to a point on the surface of the light.
+	 */
+	virtual glm::vec3 samplePoint(float u, float v) = 0;
+
+	/**
+	 * Distance along the ray (p0, dir) to the surface of the light, or -1 if it misses.
+	 */
+	virtual float intersect(glm::vec3 p0, glm::vec3 dir) = 0;
+
+	/**
+	 * Unit normal of the light surface at the point 'x' on it.
+	 */
+	virtual glm::vec3 surfaceNormal(glm::vec3 x) = 0;
+
+	/**
+	 * Total surface area, over which samplePoint() distributes its points.
+	 */
+	virtual float area() = 0;
+
+	/**
+	 * Area of the surface facing any one point far away from the light.
+	 */
+	virtual float visibleArea();
+
+	/**
+	 * Whether the surface emits from both of its sides.
+	 */
+	virtual bool isTwoSided();
+
+	glm::vec3 emitted(glm::vec3 p, glm::vec3 x);
+
+};
+
+#endif //!H_AREALIGHT
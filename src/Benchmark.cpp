@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+// Microbenchmarks for the scalar intersection, lighting and texture kernels.
+// Every kernel is run over reproducible (fixed seed) ray sets, once with a
+// hit-heavy and once with a miss-heavy distribution, and reported in ns/op
+// and millions of operations per second.
+//
+// Usage: Benchmark.out [texture.bmp]
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <cstdio>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Sphere.h"
+#include "Cylinder.h"
+#include "Cone.h"
+#include "Plane.h"
+#include "TextureBMP.h"
+#include "TextureCache.h"
+using namespace std;
+
+const int NUM_RAYS = 1 << 16; // Rays per ray set
+const int NUM_REPEATS = 20; // Timed passes over each ray set; the fastest pass is reported
+const unsigned int SEED = 12345;
+
+volatile float sink; // Keeps the optimiser from discarding kernel results
+
+
+struct RaySet
+{
+	vector<glm::vec3> p0;
+	vector<glm::vec3> dir;
+};
+
+
+// Generates rays starting on a shell around 'target'. For a hit-heavy set the rays are
+// aimed at points within 'radius' of the target; for a miss-heavy set they are aimed
+// well outside of it.
+RaySet makeRaySet(glm::vec3 target, float radius, bool hitHeavy, unsigned int seed)
+{
+	mt19937 rng(seed);
+	uniform_real_distribution<float> uni(-1.0f, 1.0f);
+	RaySet set;
+	set.p0.reserve(NUM_RAYS);
+	set.dir.reserve(NUM_RAYS);
+	for (int i = 0; i < NUM_RAYS; i++)
+	{
+		glm::vec3 offset(uni(rng), uni(rng), uni(rng));
+		if (glm::length(offset) < 1.e-3) offset = glm::vec3(0, 0, 1);
+		glm::vec3 origin = target + glm::normalize(offset) * (radius * 10.0f);
+		glm::vec3 jitter(uni(rng), uni(rng), uni(rng));
+		glm::vec3 aim = hitHeavy ? target + jitter * (radius * 0.5f)
+			: target + jitter * radius + glm::normalize(jitter + glm::vec3(1.e-3)) * (radius * 3.0f);
+		set.p0.push_back(origin);
+		set.dir.push_back(glm::normalize(aim - origin));
+	}
+	return set;
+}
+
+
+// Runs 'kernel' over every index of a set NUM_REPEATS times and prints the fastest pass.
+template <typename Kernel>
+void run(const string& name, const string& distribution, Kernel kernel)
+{
+	float acc = 0;
+	for (int i = 0; i < NUM_RAYS; i++) acc += kernel(i); // Warm-up pass
+
+	double best = 1.e30;
+	for (int r = 0; r < NUM_REPEATS; r++)
+	{
+		auto start = chrono::steady_clock::now();
+		for (int i = 0; i < NUM_RAYS; i++) acc += kernel(i);
+		auto end = chrono::steady_clock::now();
+		double ns = chrono::duration<double, nano>(end - start).count();
+		if (ns < best) best = ns;
+	}
+	sink = acc;
+
+	double nsPerOp = best / NUM_RAYS;
+	cout << left << setw(32) << name << setw(8) << distribution << right << fixed
+		<< setprecision(2) << setw(10) << nsPerOp << " ns/op"
+		<< setw(10) << 1.e3 / nsPerOp << " Mops/s" << endl;
+}
+
+
+// Benchmarks 'obj->intersect' over a hit-heavy and a miss-heavy ray set.
+void benchIntersect(const string& name, SceneObject* obj, glm::vec3 target, float radius)
+{
+	for (int hitHeavy = 1; hitHeavy >= 0; hitHeavy--)
+	{
+		RaySet set = makeRaySet(target, radius, hitHeavy, SEED);
+		run(name, hitHeavy ? "hit" : "miss", [&](int i) {
+			return obj->intersect(set.p0[i], set.dir[i]);
+		});
+	}
+}
+
+
+// Writes a synthetic 24 bit BMP so that the texture benchmark does not depend on
+// the working directory.
+bool writeTestBMP(const char* filename, int wid, int hgt)
+{
+	ofstream file(filename, ios::out | ios::binary);
+	if (!file) return false;
+	int size = wid * hgt * 3;
+	int fileSize = 54 + size, zero = 0, offset = 54, infoSize = 40;
+	short int planes = 1, bpp = 24;
+	file.write("BM", 2);
+	file.write((char*)&fileSize, 4);
+	file.write((char*)&zero, 4);
+	file.write((char*)&offset, 4);
+	file.write((char*)&infoSize, 4);
+	file.write((char*)&wid, 4);
+	file.write((char*)&hgt, 4);
+	file.write((char*)&planes, 2);
+	file.write((char*)&bpp, 2);
+	for (int i = 0; i < 6; i++) file.write((char*)&zero, 4);
+	vector<char> pixels(size);
+	for (int i = 0; i < size; i++) pixels[i] = (char)(i * 31);
+	file.write(pixels.data(), size);
+	return true;
+}
+
+
+int main(int argc, char* argv[])
+{
+	cout << "Rays per set: " << NUM_RAYS << ", passes: " << NUM_REPEATS << ", seed: " << SEED << endl;
+
+	Sphere sphere(glm::vec3(-12.0, 0.0, -110.0), 15.0);
+	benchIntersect("Sphere::intersect", &sphere, glm::vec3(-12.0, 0.0, -110.0), 15.0);
+
+	Cylinder cylinder(glm::vec3(13.0, -15.0, -70.0), 3.0, 10.0);
+	benchIntersect("Cylinder::intersect", &cylinder, glm::vec3(13.0, -10.0, -70.0), 3.0);
+
+	Cone cone(glm::vec3(-8.0, -15.0, -70.0), 4.0, 12.0);
+	benchIntersect("Cone::intersect", &cone, glm::vec3(-8.0, -11.0, -70.0), 4.0);
+
+	Plane plane(glm::vec3(-50., -15, -40), glm::vec3(50., -15, -40),
+		glm::vec3(50., -15, -200), glm::vec3(-50., -15, -200));
+	benchIntersect("Plane::intersect", &plane, glm::vec3(0, -15, -120), 50.0);
+
+	// Points on the plane of the quad, either inside or outside of its edges
+	for (int inside = 1; inside >= 0; inside--)
+	{
+		mt19937 rng(SEED);
+		uniform_real_distribution<float> uni(-1.0f, 1.0f);
+		vector<glm::vec3> pts(NUM_RAYS);
+		for (int i = 0; i < NUM_RAYS; i++)
+		{
+			float x = uni(rng) * 49.0f, z = uni(rng) * 79.0f;
+			if (!inside) x += (x < 0 ? -51.0f : 51.0f);
+			pts[i] = glm::vec3(x, -15, -120 + z);
+		}
+		run("Plane::isInside", inside ? "hit" : "miss", [&](int i) {
+			return plane.isInside(pts[i]) ? 1.0f : 0.0f;
+		});
+	}
+
+	// Lighting at random points on the sphere, with the light in front of ("hit") or
+	// behind ("miss") the shaded points
+	for (int front = 1; front >= 0; front--)
+	{
+		RaySet set = makeRaySet(glm::vec3(-12.0, 0.0, -110.0), 15.0, true, SEED);
+		vector<glm::vec3> hits(NUM_RAYS);
+		for (int i = 0; i < NUM_RAYS; i++)
+		{
+			float t = sphere.intersect(set.p0[i], set.dir[i]);
+			hits[i] = set.p0[i] + set.dir[i] * (t > 0 ? t : 0);
+		}
+		glm::vec3 lightPos = front ? glm::vec3(10, 40, -3) : glm::vec3(-12, 0, -300);
+		run("SceneObject::lighting", front ? "hit" : "miss", [&](int i) {
+			glm::vec3 col = sphere.lighting(lightPos, -set.dir[i], hits[i]);
+			return col.r + col.g + col.b;
+		});
+	}
+
+	// Texture lookups inside ("hit") and outside ("miss") of the [0,1] range, and texel
+	// by texel down the columns of the texture ("column"), as from the scanlines of a
+	// texture rotated by 90 degrees, with each memory layout (the streamed texture in a
+	// cache large enough to hold it, warmed up by the first run)
+	const char* texFile = "bench_texture.bmp";
+	bool generated = argc < 2;
+	if (generated) writeTestBMP(texFile, 1024, 1024);
+	const char* layoutNames[] = { " (rows)", " (tiled)", " (cached)" };
+	TextureCache cache;
+	for (int layout = TextureBMP::ROW_MAJOR; layout <= TextureBMP::STREAMED; layout++)
+	{
+		TextureBMP texture(generated ? texFile : argv[1], (TextureBMP::Layout)layout, &cache);
+		for (int dist = 0; dist < 3; dist++)
+		{
+			mt19937 rng(SEED);
+			uniform_real_distribution<float> uni(0.0f, 1.0f);
+			vector<glm::vec2> st(NUM_RAYS);
+			for (int i = 0; i < NUM_RAYS; i++)
+			{
+				st[i] = glm::vec2(uni(rng), uni(rng));
+				int w = texture.getWidth(), h = texture.getHeight();
+				if (dist == 1) st[i] = glm::vec2((i / h % w + 0.5f) / w, (i % h + 0.5f) / h);
+				if (dist == 2) st[i] += glm::vec2(1.0f);
+			}
+			const char* distName = dist == 0 ? "hit" : (dist == 1 ? "column" : "miss");
+			run(string("TextureBMP::getColorAt") + layoutNames[layout], distName, [&](int i) {
+				glm::vec3 col = texture.getColorAt(st[i].x, st[i].y);
+				return col.r + col.g + col.b;
+			});
+			run(string("TextureBMP::trilinear") + layoutNames[layout], distName, [&](int i) {
+				glm::vec2 dx(st[i].y * 0.01f, 0), dy(0, st[i].x * 0.01f); // Footprints of up to ten texels
+				glm::vec3 col = texture.getColorAt(st[i].x, st[i].y, dx, dy);
+				return col.r + col.g + col.b;
+			});
+		}
+	}
+	if (generated) remove(texFile);
+
+	return 0;
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "BlueNoiseSampler.h"
+#include <math.h>
+
+std::vector<float> BlueNoiseSampler::mask;
+
+const float SIGMA = 1.9f; // Width of the energy kernel, in cells
+const int KERNEL_RADIUS = 6;
+
+BlueNoiseSampler::BlueNoiseSampler()
+{
+	if (mask.empty()) buildMask();
+}
+
+/**
+* Ranks the cells of the mask in the manner of the void-and-cluster method:
+* starting from an empty mask, the cell in the largest void, i.e. with the lowest
+* energy of the cells already ranked (a Gaussian of their toroidal distance),
+* is ranked next. The ranks, divided by the number of cells, form the mask.
+*/
+void BlueNoiseSampler::buildMask()
+{
+	const int n = SIZE * SIZE;
+	std::vector<float> energy(n, 0);
+	std::vector<bool> ranked(n, false);
+	mask.assign(n, 0);
+
+	float kernel[2 * KERNEL_RADIUS + 1][2 * KERNEL_RADIUS + 1];
+	for (int dy = -KERNEL_RADIUS; dy <= KERNEL_RADIUS; dy++)
+	{
+		for (int dx = -KERNEL_RADIUS; dx <= KERNEL_RADIUS; dx++)
+		{
+			kernel[dy + KERNEL_RADIUS][dx + KERNEL_RADIUS] = expf(-(dx * dx + dy * dy) / (2 * SIGMA * SIGMA));
+		}
+	}
+
+	unsigned int state = 1;
+	for (int rank = 0; rank < n; rank++)
+	{
+		// Lowest energy cell; ties (as at the start) are broken pseudo-randomly
+		int best = -1;
+		float bestEnergy = 1.e30f;
+		int start = (state = state * 1664525u + 1013904223u) % n;
+		for (int k = 0; k < n; k++)
+		{
+			int c = (start + k) % n;
+			if (!ranked[c] && energy[c] < bestEnergy) {
+				bestEnergy = energy[c];
+				best = c;
+			}
+		}
+		ranked[best] = true;
+		mask[best] = (rank + 0.5f) / n;
+
+		int bx = best % SIZE, by = best / SIZE;
+		for (int dy = -KERNEL_RADIUS; dy <= KERNEL_RADIUS; dy++)
+		{
+			for (int dx = -KERNEL_RADIUS; dx <= KERNEL_RADIUS; dx++)
+			{
+				int x = (bx + dx + SIZE) % SIZE, y = (by + dy + SIZE) % SIZE;
+				energy[y * SIZE + x] += kernel[dy + KERNEL_RADIUS][dx + KERNEL_RADIUS];
+			}
+		}
+	}
+}
+
+glm::vec2 BlueNoiseSampler::get2D(glm::ivec2 pixel, int index, int count, int dim)
+{
+	// Each dimension reads the mask at its own toroidal shift; the second
+	// coordinate at a further shift of half the mask
+	unsigned int shift = hash(dim, 0, 0);
+	int x = (pixel.x + (shift & 63)) & (SIZE - 1);
+	int y = (pixel.y + ((shift >> 6) & 63)) & (SIZE - 1);
+	float offsetX = mask[y * SIZE + x];
+	float offsetY = mask[((y + SIZE / 2) & (SIZE - 1)) * SIZE + ((x + SIZE / 2) & (SIZE - 1))];
+
+	// R2 sequence (Roberts), based on the plastic constant
+	const double a1 = 0.7548776662466927, a2 = 0.5698402909980532;
+	float u = (float)fmod(0.5 + a1 * index + offsetX, 1.0);
+	float v = (float)fmod(0.5 + a2 * index + offsetY, 1.0);
+	return glm::vec2(u, v);
+}
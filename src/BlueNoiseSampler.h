@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#ifndef H_BLUENOISESAMPLER
+#define H_BLUENOISESAMPLER
+#include <vector>
+#include "Sampler.h"
+
+/**
+ * Blue noise dithered sampling: the points of the R2 low discrepancy sequence are
+ * shifted (toroidally) by a per-pixel offset read from a tileable blue noise
+ * mask, so that the error left in each pixel is uncorrelated with, and so looks
+ * like high frequency noise next to, the error of its neighbours. The mask is
+ * generated once, when the first sampler is created.
+ */
+class BlueNoiseSampler : public Sampler
+{
+
+private:
+	static const int SIZE = 64; // Width and height of the blue noise mask
+	static std::vector<float> mask;
+
+	static void buildMask();
+
+public:
+	BlueNoiseSampler();
+
+	glm::vec2 get2D(glm::ivec2 pixel, int index, int count, int dim);
+
+};
+
+#endif //!H_BLUENOISESAMPLER
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "Camera.h"
+#include <math.h>
+
+/**
+* Returns the ray through the point (dx, dy) of the cell in column 'i' and row 'j'
+* of the image plane, where (0, 0) is the bottom left corner of the cell and
+* (0.5, 0.5) its center. Row 0 is at the bottom of the image.
+*/
+Ray Camera::primaryRay(int i, int j, float dx, float dy)
+{
+	float cellX = width / numDiv; // cell width
+	float cellY = height / numDiv; // cell height
+	float xp = -width * 0.5f + i * cellX; // grid point
+	float yp = -height * 0.5f + j * cellY;
+	glm::vec3 dir(xp + dx * cellX, yp + dy * cellY, -edist); // Direction of the primary ray
+	Ray ray(eye, dir);
+
+	// Differentials of the unit direction, for rays one cell across and up
+	float len2 = glm::dot(dir, dir);
+	float len3 = len2 * sqrtf(len2);
+	ray.dDdx = (glm::vec3(cellX, 0, 0) * len2 - dir * (dir.x * cellX)) / len3;
+	ray.dDdy = (glm::vec3(0, cellY, 0) * len2 - dir * (dir.y * cellY)) / len3;
+	ray.hasDifferentials = true;
+	return ray;
+}
+
+/**
+* Finds where the point 'p' appears on the image plane, in cells: (i + dx, j + dy)
+* for point (dx, dy) of cell (i, j). Returns false for points behind the camera.
+*/
+bool Camera::project(glm::vec3 p, glm::vec2& cell)
+{
+	glm::vec3 d = p - eye;
+	if (d.z >= 0) return false;
+	float s = edist / -d.z; // Scales d onto the image plane
+	cell.x = (d.x * s + width * 0.5f) * numDiv / width;
+	cell.y = (d.y * s + height * 0.5f) * numDiv / height;
+	return true;
+}
+
+void Camera::setEye(glm::vec3 e)
+{
+	eye = e;
+}
+
+glm::vec3 Camera::getEye()
+{
+	return eye;
+}
+
+int Camera::getNumDiv()
+{
+	return numDiv;
+}
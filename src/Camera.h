@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#ifndef H_CAMERA
+#define H_CAMERA
+#include <glm/glm.hpp>
+#include "Ray.h"
+
+/**
+ * Pinhole camera at 'eye' looking down the negative z axis. The image plane
+ * is 'width' x 'height' units in size at distance 'edist' from the eye and
+ * is divided into 'numDiv' x 'numDiv' cells (pixels).
+ */
+class Camera
+{
+
+private:
+	glm::vec3 eye = glm::vec3(0);
+	float width = 20;
+	float height = 20;
+	float edist = 40;
+	int numDiv = 500;
+
+public:
+	Camera() {};
+
+	Camera(glm::vec3 e, float w, float h, float d, int n) : eye(e), width(w), height(h), edist(d), numDiv(n) {}
+
+	Ray primaryRay(int i, int j, float dx = 0.5, float dy = 0.5);
+
+	bool project(glm::vec3 p, glm::vec2& cell);
+
+	void setEye(glm::vec3 e);
+
+	glm::vec3 getEye();
+
+	int getNumDiv();
+
+};
+
+#endif //!H_CAMERA
@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "CheckerboardRenderer.h"
+#include "Parallel.h"
+#include <math.h>
+#include <atomic>
+#include <algorithm>
+
+const float DEPTH_TOLERANCE = 0.01; // Relative depth difference of neighbours on the same surface
+const float NORMAL_POWER = 16; // Sharpness of the normal weight of neighbours
+
+
+/**
+* Estimates the colour added by secondary rays at the untraced pixel (i, j).
+* Returns false if neither the previous frame nor a neighbour can provide it.
+*/
+bool CheckerboardRenderer::reconstruct(int i, int j, glm::vec3& result)
+{
+	int n = camera.getNumDiv();
+	int p = j * n + i;
+	int tile = (j / TILE_SIZE) * ((n + TILE_SIZE - 1) / TILE_SIZE) + i / TILE_SIZE;
+
+	// The previous frame traced this pixel, and nothing it depends on was edited since
+	if (hasPrevious && !stale[tile] && previousEye == camera.getEye() && previousIndex[p] == index[p]
+		&& fabsf(previousDepth[p] - depth[p]) <= DEPTH_TOLERANCE * depth[p]) {
+		result = previousSecondary[p];
+		return true;
+	}
+
+	// Edge-aware interpolation of the traced neighbours
+	const int dx[4] = { -1, 1, 0, 0 };
+	const int dy[4] = { 0, 0, -1, 1 };
+	glm::vec3 sum(0);
+	float weightSum = 0;
+	for (int k = 0; k < 4; k++)
+	{
+		int x = i + dx[k], y = j + dy[k];
+		if (x < 0 || x >= n || y < 0 || y >= n) continue;
+		int q = y * n + x;
+		if (index[q] != index[p]) continue;
+		float d = fabsf(depth[q] - depth[p]) / (DEPTH_TOLERANCE * depth[p]);
+		if (d > 1) continue;
+		float w = powf(std::max(0.0f, glm::dot(normal[p], normal[q])), NORMAL_POWER) * (1 - d);
+		sum += w * secondary[q];
+		weightSum += w;
+	}
+	if (weightSum <= 0) return false;
+	result = sum / weightSum;
+	return true;
+}
+
+/**
+* Renders the scene into 'frame' (row major, starting from the bottom left pixel)
+* and the AOVs enabled in 'aovs', if given. Bands of tiles, then rows, are shared
+* between threads.
+*/
+void CheckerboardRenderer::render(std::vector<glm::vec3>& frame, FrameBuffer* aovs)
+{
+	int n = camera.getNumDiv();
+	int tilesX = (n + TILE_SIZE - 1) / TILE_SIZE;
+	frame.resize(n * n);
+	secondary.resize(n * n);
+	index.resize(n * n);
+	depth.resize(n * n);
+	normal.resize(n * n);
+	dependencies.assign(tilesX * tilesX, std::vector<bool>(scene.objects.size(), false));
+	if (previousDependencies.size() != dependencies.size()
+		|| previousDependencies[0].size() != scene.objects.size()) invalidateAll();
+	std::vector<glm::vec3> local(n * n);
+	std::atomic<long long> full(0);
+
+	// Primary rays and local shading everywhere, secondary rays on one colour of the board
+	parallelFor(tilesX, [&](int ty) {
+		long long bandFull = 0;
+		for (int tx = 0; tx < tilesX; tx++)
+		{
+			Ray::touched = &dependencies[ty * tilesX + tx];
+			for (int j = ty * TILE_SIZE; j < std::min((ty + 1) * TILE_SIZE, n); j++)
+			{
+				for (int i = tx * TILE_SIZE; i < std::min((tx + 1) * TILE_SIZE, n); i++)
+				{
+					int p = j * n + i;
+					Ray ray = camera.primaryRay(i, j);
+					ray.closestPt(scene.objects);
+					scene.countRay();
+					if (aovs != nullptr) aovs->writeHit(p, scene, ray);
+					index[p] = ray.index;
+					depth[p] = ray.dist;
+					local[p] = scene.localShading(ray);
+					if (ray.index == -1) { // Background: no secondary rays to trace
+						frame[p] = local[p];
+						secondary[p] = glm::vec3(0);
+						continue;
+					}
+					glm::vec3 normalVec = scene.objects[ray.index]->normal(ray.hit);
+					normal[p] = glm::dot(normalVec, ray.dir) > 0 ? -normalVec : normalVec;
+					if ((i + j) % 2 == parity) {
+						frame[p] = scene.shade(ray, 1);
+						secondary[p] = frame[p] - local[p];
+						bandFull++;
+					}
+				}
+			}
+		}
+		Ray::touched = nullptr;
+		full += bandFull;
+	});
+
+	// Reconstruction of the other pixels, tracing those that cannot be reconstructed
+	parallelFor(n, [&](int j) {
+		long long rowFull = 0;
+		for (int i = 0; i < n; i++)
+		{
+			int p = j * n + i;
+			if ((i + j) % 2 == parity || index[p] == -1) continue;
+			glm::vec3 added;
+			if (reconstruct(i, j, added)) {
+				frame[p] = local[p] + added;
+				continue;
+			}
+			frame[p] = scene.trace(camera.primaryRay(i, j), 1);
+			rowFull++;
+		}
+		full += rowFull;
+	});
+	traced = full;
+
+	// Only the traced pixels are kept: they are the ones skipped in the next frame
+	previousSecondary.swap(secondary);
+	previousIndex.swap(index);
+	previousDepth.swap(depth);
+	previousDependencies.swap(dependencies);
+	stale.assign(previousDependencies.size(), false);
+	previousEye = camera.getEye();
+	hasPrevious = true;
+	parity = 1 - parity;
+}
+
+void CheckerboardRenderer::invalidate(int object)
+{
+	for (size_t t = 0; t < previousDependencies.size(); t++)
+	{
+		if (object >= 0 && (size_t)object < previousDependencies[t].size() && previousDependencies[t][object]) stale[t] = true;
+	}
+}
+
+void CheckerboardRenderer::invalidateAll()
+{
+	hasPrevious = false;
+}
+
+long long CheckerboardRenderer::getTracedPixels()
+{
+	return traced;
+}
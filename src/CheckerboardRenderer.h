@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#ifndef H_CHECKERBOARD
+#define H_CHECKERBOARD
+#include <glm/glm.hpp>
+#include <vector>
+#include "Scene.h"
+#include "Camera.h"
+#include "FrameBuffer.h"
+
+/**
+ * Whitted renderer that traces secondary rays (shadow, reflection, refraction and
+ * ambient occlusion rays) for only half of the pixels, in a checkerboard pattern
+ * that alternates every frame. Every pixel gets its primary ray and the local
+ * shading of its hit (Scene::localShading), which needs no further rays. For a
+ * traced pixel, the difference between its full colour and the local shading is
+ * what the secondary rays added. For the other pixels that difference is
+ * reconstructed: from the previous frame, which traced them, if the camera has
+ * not moved and the pixel still shows the same surface; otherwise from the four
+ * traced neighbours on the same surface, weighted by normal and depth. A pixel with
+ * no such neighbour (e.g. a one pixel wide feature) is traced in full. As in
+ * IncrementalRenderer, the objects met by the rays of each 16x16 tile are recorded,
+ * so that an edit of an object stops the reuse of the previous frame in the tiles
+ * that depend on it. Background pixels need no rays beyond the primary one.
+ */
+class CheckerboardRenderer
+{
+
+private:
+	static const int TILE_SIZE = 16;
+
+	Scene& scene;
+	Camera& camera;
+	int parity = 0; // Pixels with (i + j) % 2 == parity are traced in the current frame
+	glm::vec3 previousEye = glm::vec3(0);
+	bool hasPrevious = false;
+	std::vector<glm::vec3> secondary; // Colour added by secondary rays, per pixel
+	std::vector<glm::vec3> previousSecondary;
+	std::vector<int> index; // Object hit by the primary ray, -1 for none
+	std::vector<int> previousIndex;
+	std::vector<float> depth;
+	std::vector<float> previousDepth;
+	std::vector<glm::vec3> normal;
+	std::vector<std::vector<bool>> dependencies; // Objects met by the rays of each tile
+	std::vector<std::vector<bool>> previousDependencies;
+	std::vector<bool> stale; // Tiles of the previous frame changed by an edit since
+	long long traced = 0; // Pixels traced in full in the last frame
+
+	bool reconstruct(int i, int j, glm::vec3& result);
+
+public:
+	CheckerboardRenderer(Scene& s, Camera& c) : scene(s), camera(c) {}
+
+	void render(std::vector<glm::vec3>& frame, FrameBuffer* aovs = nullptr);
+
+	/**
+	 * Stops the reuse of the previous frame in the tiles that depend on the object
+	 * with the given index. To be called after an edit of the object.
+	 */
+	void invalidate(int object);
+
+	/**
+	 * Stops the reuse of the previous frame everywhere, e.g. after an edit of the lights.
+	 */
+	void invalidateAll();
+
+	long long getTracedPixels();
+
+};
+
+#endif //!H_CHECKERBOARD
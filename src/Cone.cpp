@@ -52,3 +52,14 @@ glm::vec3 Cone::normal(glm::vec3 p)
     n = glm::normalize(n);
     return n;
 }
+
+/**
+* Texture coordinates of a point on the side: the angle around the axis and the
+* fraction of the height.
+*/
+glm::vec2 Cone::textureCoords(glm::vec3 p)
+{
+	float s = (0.5 - atan2(p.z - center.z, p.x - center.x) + 3.14) / (2 * 3.14);
+	float t = (p.y - center.y) / height;
+	return glm::vec2(s, t);
+}
@@ -51,4 +51,15 @@ glm::vec3 Cylinder::normal(glm::vec3 p)
     glm::vec3 n = glm::vec3(vdif.x, 0, vdif.z);
     n = glm::normalize(n);
     return n;
-}
\ No newline at end of file
+}
+
+/**
+* Texture coordinates of a point on the side: the angle around the axis and the
+* fraction of the height.
+*/
+glm::vec2 Cylinder::textureCoords(glm::vec3 p)
+{
+	float s = (0.5 - atan2(p.z - center.z, p.x - center.x) + 3.14) / (2 * 3.14);
+	float t = (p.y - center.y) / height;
+	return glm::vec2(s, t);
+}
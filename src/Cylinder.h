@@ -30,6 +30,8 @@ public:
 
 	glm::vec3 normal(glm::vec3 p);
 
+	glm::vec2 textureCoords(glm::vec3 p);
+
 };
 
 #endif //!H_CYLINDER
@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "DeferredRenderer.h"
+#include "Parallel.h"
+#include <math.h>
+#include <algorithm>
+
+const int BATCH_SIZE = 16; // Hit records shaded together
+
+/**
+* Intersects the primary ray of every pixel with the scene and fills the G-buffer
+* and, with 'aovs', the AOV channels. Rows are shared between threads.
+*/
+void DeferredRenderer::visibilityPass(FrameBuffer* aovs)
+{
+	int n = camera.getNumDiv();
+	gbuffer.resize(n * n);
+	parallelFor(n, [&](int j) {
+		for (int i = 0; i < n; i++)
+		{
+			Ray ray = camera.primaryRay(i, j);
+			ray.closestPt(scene.objects);
+			scene.countRay();
+			if (aovs != nullptr) aovs->writeHit(j * n + i, scene, ray);
+			HitRecord& rec = gbuffer[j * n + i];
+			rec.index = ray.index;
+			if (ray.index == -1) continue;
+			rec.t = ray.dist;
+			rec.normal = scene.objects[ray.index]->normal(ray.hit);
+			rec.uv = scene.textureCoords(ray.index, ray.hit);
+		}
+	});
+}
+
+/**
+* Shades 'count' (at most BATCH_SIZE) pixels that all hit the same object.
+*/
+void DeferredRenderer::shadeBatch(const int* pixels, int count, std::vector<glm::vec3>& frame)
+{
+	int n = camera.getNumDiv();
+	int index = gbuffer[pixels[0]].index;
+	SceneObject* obj = scene.objects[index];
+	bool spec = obj->isSpecular();
+	float shin = obj->getShininess();
+
+	// Batch data, one array per component
+	float nx[BATCH_SIZE], ny[BATCH_SIZE], nz[BATCH_SIZE]; // Normals
+	float vx[BATCH_SIZE], vy[BATCH_SIZE], vz[BATCH_SIZE]; // View vectors
+	float cr[BATCH_SIZE], cg[BATCH_SIZE], cb[BATCH_SIZE]; // Surface colours
+	float lx[BATCH_SIZE], ly[BATCH_SIZE], lz[BATCH_SIZE]; // Light vectors
+	float lr[BATCH_SIZE], lg[BATCH_SIZE], lb[BATCH_SIZE]; // Light radiance times visibility
+	float lDotn[BATCH_SIZE];
+	float outr[BATCH_SIZE], outg[BATCH_SIZE], outb[BATCH_SIZE];
+	Ray rays[BATCH_SIZE];
+
+	for (int k = 0; k < count; k++)
+	{
+		const HitRecord& rec = gbuffer[pixels[k]];
+		rays[k] = camera.primaryRay(pixels[k] % n, pixels[k] / n);
+		rays[k].index = rec.index;
+		rays[k].dist = rec.t;
+		rays[k].hit = rays[k].p0 + rays[k].dir * rec.t;
+		glm::vec3 col = scene.surfaceColor(rays[k], rec.uv, rec.normal);
+		nx[k] = rec.normal.x; ny[k] = rec.normal.y; nz[k] = rec.normal.z;
+		vx[k] = -rays[k].dir.x; vy[k] = -rays[k].dir.y; vz[k] = -rays[k].dir.z;
+		cr[k] = col.r; cg[k] = col.g; cb[k] = col.b;
+	}
+
+	// Ambient term, scaled by the occlusion of each record
+	glm::vec3 ambient = obj->ambient(glm::vec3(1));
+	for (int k = 0; k < count; k++)
+	{
+		float ao = 1;
+		if (scene.aoSamples > 0) {
+			glm::vec3 n(nx[k], ny[k], nz[k]);
+			ao = scene.ambientOcclusion(rays[k].hit, glm::dot(n, rays[k].dir) > 0 ? -n : n, scene.aoSamples);
+		}
+		outr[k] = ao * ambient.r * cr[k];
+		outg[k] = ao * ambient.g * cg[k];
+		outb[k] = ao * ambient.b * cb[k];
+	}
+
+	if (scene.lightTree.size() > 0) {
+		// Stochastic light selection differs per pixel: shade each record on its own
+		for (int k = 0; k < count; k++)
+		{
+			glm::vec3 col(cr[k], cg[k], cb[k]);
+			glm::vec3 c = scene.directLighting(obj, col, rays[k].hit, -rays[k].dir, gbuffer[pixels[k]].normal);
+			outr[k] += c.r; outg[k] += c.g; outb[k] += c.b;
+		}
+	}
+	else {
+		for (Light* light : scene.lights)
+		{
+			// Light vectors and shadow rays are evaluated per record
+			for (int k = 0; k < count; k++)
+			{
+				glm::vec3 lightVec;
+				float lightDist;
+				glm::vec3 radiance = light->illuminate(rays[k].hit, lightVec, lightDist);
+				lDotn[k] = lightVec.x * nx[k] + lightVec.y * ny[k] + lightVec.z * nz[k];
+				float visibility = scene.lightVisibility(light, rays[k].hit, lightVec, lightDist, lDotn[k], radiance);
+				lx[k] = lightVec.x; ly[k] = lightVec.y; lz[k] = lightVec.z;
+				lr[k] = visibility * radiance.r; lg[k] = visibility * radiance.g; lb[k] = visibility * radiance.b;
+			}
+
+			// Diffuse and specular terms for the whole batch
+			for (int k = 0; k < count; k++)
+			{
+				float d = lDotn[k] > 0 ? lDotn[k] : 0;
+				float rx = 2 * lDotn[k] * nx[k] - lx[k]; // Reflected light vector
+				float ry = 2 * lDotn[k] * ny[k] - ly[k];
+				float rz = 2 * lDotn[k] * nz[k] - lz[k];
+				float rDotv = rx * vx[k] + ry * vy[k] + rz * vz[k];
+				float s = (spec && rDotv > 0) ? powf(rDotv, shin) : 0;
+				outr[k] += lr[k] * (d * cr[k] + s);
+				outg[k] += lg[k] * (d * cg[k] + s);
+				outb[k] += lb[k] * (d * cb[k] + s);
+			}
+		}
+	}
+
+	bool secondary = obj->isReflective() || obj->isRefractive() || obj->isTransparent();
+	for (int k = 0; k < count; k++)
+	{
+		glm::vec3 color = glm::vec3(outr[k], outg[k], outb[k]);
+		color += scene.caustics(glm::vec3(cr[k], cg[k], cb[k]), rays[k].hit, gbuffer[pixels[k]].normal);
+		color = scene.fog(color, rays[k].hit);
+		if (secondary) color = scene.secondaryRays(obj, color, rays[k], gbuffer[pixels[k]].normal, 1);
+		frame[pixels[k]] = color;
+	}
+}
+
+/**
+* Renders the scene into 'frame' (row major, starting from the bottom left pixel)
+* and the AOVs enabled in 'aovs', if given.
+*/
+void DeferredRenderer::render(std::vector<glm::vec3>& frame, FrameBuffer* aovs)
+{
+	int n = camera.getNumDiv();
+	frame.assign(n * n, glm::vec3(0)); // Background colour = (0,0,0)
+
+	visibilityPass(aovs);
+
+	// Group the pixels by the object hit (counting sort)
+	int numObjects = scene.objects.size();
+	std::vector<int> start(numObjects + 1, 0);
+	for (const HitRecord& rec : gbuffer)
+	{
+		if (rec.index >= 0) start[rec.index + 1]++;
+	}
+	for (int m = 0; m < numObjects; m++) start[m + 1] += start[m];
+	order.resize(start[numObjects]);
+	std::vector<int> next(start.begin(), start.end() - 1);
+	for (size_t p = 0; p < gbuffer.size(); p++)
+	{
+		if (gbuffer[p].index >= 0) order[next[gbuffer[p].index]++] = p;
+	}
+
+	// Batches write to disjoint pixels, so they are shaded in parallel
+	std::vector<int> batches; // First record of each batch; batches end at the next one or an object boundary
+	for (int m = 0; m < numObjects; m++)
+	{
+		for (int b = start[m]; b < start[m + 1]; b += BATCH_SIZE) batches.push_back(b);
+	}
+	parallelFor(batches.size(), [&](int k) {
+		int b = batches[k];
+		int index = gbuffer[order[b]].index;
+		shadeBatch(&order[b], std::min(BATCH_SIZE, start[index + 1] - b), frame);
+	});
+}
+
+std::vector<HitRecord>& DeferredRenderer::getGBuffer()
+{
+	return gbuffer;
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#ifndef H_DEFERRED
+#define H_DEFERRED
+#include <glm/glm.hpp>
+#include <vector>
+#include "Scene.h"
+#include "Camera.h"
+#include "FrameBuffer.h"
+
+/**
+ * Compact record of the closest intersection of a primary ray.
+ */
+struct HitRecord
+{
+	int index = -1; // Index of the object hit, -1 for none
+	float t = 0; // Distance along the primary ray
+	glm::vec3 normal = glm::vec3(0); // Unit surface normal at the point of intersection
+	glm::vec2 uv = glm::vec2(0); // Texture coordinates at the point of intersection
+};
+
+/**
+ * Renders the scene in two phases. The visibility pass intersects the primary ray of
+ * every pixel with the scene and stores the result in a G-buffer of hit records. The
+ * shading pass groups the pixels by the object (material) they hit and shades them in
+ * fixed-size batches, laid out as arrays of components so the lighting loops can be
+ * vectorised. Reflection and refraction rays are traced per pixel as before.
+ */
+class DeferredRenderer
+{
+
+private:
+	Scene& scene;
+	Camera& camera;
+	std::vector<HitRecord> gbuffer; // One hit record per pixel
+	std::vector<int> order; // Pixel indices grouped by the object hit
+
+	void visibilityPass(FrameBuffer* aovs);
+	void shadeBatch(const int* pixels, int count, std::vector<glm::vec3>& frame);
+
+public:
+	DeferredRenderer(Scene& s, Camera& c) : scene(s), camera(c) {}
+
+	void render(std::vector<glm::vec3>& frame, FrameBuffer* aovs = nullptr);
+
+	std::vector<HitRecord>& getGBuffer();
+
+};
+
+#endif //!H_DEFERRED
@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "Denoiser.h"
+#include "Parallel.h"
+#include <math.h>
+#include <algorithm>
+
+const float KERNEL[3] = { 3.0f / 8, 1.0f / 4, 1.0f / 16 }; // 1D B3 spline weights for offsets 0, 1, 2
+const float ALBEDO_MIN = 0.05; // Keeps the division by the albedo finite
+const int NORMAL_SQUARINGS = 6; // Sharpness of the normal edge stop: cosine to the power 2^6 = 64
+const float DEPTH_SIGMA = 0.02; // Relative depth difference tolerated per pixel of tap spacing
+const float ALBEDO_SIGMA = 0.1;
+const float LUMINANCE_SIGMA = 4; // Luminance difference tolerated, in standard deviations, at strength 1
+
+
+namespace
+{
+	float luminance(glm::vec3 c)
+	{
+		return 0.2126f * c.r + 0.7152f * c.g + 0.0722f * c.b;
+	}
+
+	// Normal edge stop: the clamped cosine to the power 2^NORMAL_SQUARINGS, by
+	// repeated squaring
+	float normalWeight(float cosine)
+	{
+		float w = std::max(0.0f, cosine);
+		for (int k = 0; k < NORMAL_SQUARINGS; k++) w *= w;
+		return w;
+	}
+}
+
+
+/**
+* Fills 'albedo' from the albedo AOV.
+*/
+void Denoiser::demodulationAlbedo()
+{
+	const FrameBuffer& fb = *features;
+	albedo.resize(fb.albedo.size());
+	int n = camera.getNumDiv();
+	parallelFor(n, [&](int j) {
+		for (int p = j * n; p < (j + 1) * n; p++)
+		{
+			// The colour of mirrors and see-through objects mostly shows other surfaces:
+			// it is filtered as it is instead of being divided by the albedo
+			int index = fb.objectId[p];
+			SceneObject* obj = index >= 0 ? scene.objects[index] : nullptr;
+			bool passesLight = obj != nullptr && (obj->isReflective() || obj->isRefractive() || obj->isTransparent());
+			albedo[p] = passesLight ? glm::vec3(1) : fb.albedo[p];
+		}
+	});
+}
+
+/**
+* Features of the centre pixel p of a filter with taps 'step' pixels apart.
+*/
+Denoiser::Centre Denoiser::centre(int p, int step)
+{
+	Centre c;
+	c.normal = features->normal[p];
+	c.albedo = albedo[p];
+	c.depth = features->depth[p];
+	c.invDepthScale = 1.0f / (DEPTH_SIGMA * step * c.depth);
+	return c;
+}
+
+/**
+* Edge stopping weight of pixel q for a filter centred on 'c', from the differences
+* of their normals, depths and albedos, times exp(-'exponent'). The exponential
+* terms are summed so that only one expf is taken per tap.
+*/
+float Denoiser::featureWeight(const Centre& c, int q, float exponent)
+{
+	float w = normalWeight(glm::dot(c.normal, features->normal[q]));
+	if (w == 0) return 0; // Facing away, or an edge too sharp to filter across
+	glm::vec3 da = c.albedo - albedo[q];
+	exponent += fabsf(c.depth - features->depth[q]) * c.invDepthScale
+		+ glm::dot(da, da) * (1.0f / (ALBEDO_SIGMA * ALBEDO_SIGMA));
+	return w * expf(-exponent);
+}
+
+/**
+* Estimates the luminance variance of every pixel of 'src' from its 5x5
+* neighbourhood on the same surface.
+*/
+void Denoiser::estimateVariance(const std::vector<glm::vec3>& src, std::vector<float>& var)
+{
+	int n = camera.getNumDiv();
+	const std::vector<float>& depth = features->depth;
+	parallelFor(n, [&](int j) {
+		for (int i = 0; i < n; i++)
+		{
+			int p = j * n + i;
+			var[p] = 0;
+			if (depth[p] == 0) continue;
+			Centre c = centre(p, 1);
+			float sum = 0, sumSq = 0, weightSum = 0;
+			for (int y = std::max(j - 2, 0); y <= std::min(j + 2, n - 1); y++)
+			{
+				for (int x = std::max(i - 2, 0); x <= std::min(i + 2, n - 1); x++)
+				{
+					int q = y * n + x;
+					if (depth[q] == 0) continue;
+					float w = featureWeight(c, q, 0);
+					float l = luminance(src[q]);
+					sum += w * l;
+					sumSq += w * l * l;
+					weightSum += w;
+				}
+			}
+			float mean = sum / weightSum;
+			var[p] = std::max(0.0f, sumSq / weightSum - mean * mean);
+		}
+	});
+}
+
+/**
+* One a-trous pass from 'src' to 'dst' with taps 'step' pixels apart; 'srcVar' and
+* 'dstVar' are the luminance variances of the two images. Tiles are shared between
+* threads.
+*/
+void Denoiser::filterPass(const std::vector<glm::vec3>& src, const std::vector<float>& srcVar,
+	std::vector<glm::vec3>& dst, std::vector<float>& dstVar, int step)
+{
+	int n = camera.getNumDiv();
+	int tilesX = (n + TILE_SIZE - 1) / TILE_SIZE;
+	float sigma = LUMINANCE_SIGMA * strength;
+	const std::vector<float>& depth = features->depth;
+
+	parallelFor(tilesX * tilesX, [&](int t) {
+		int x0 = (t % tilesX) * TILE_SIZE, y0 = (t / tilesX) * TILE_SIZE;
+		for (int j = y0; j < std::min(y0 + TILE_SIZE, n); j++)
+		{
+			for (int i = x0; i < std::min(x0 + TILE_SIZE, n); i++)
+			{
+				int p = j * n + i;
+				if (depth[p] == 0) { // Background
+					dst[p] = src[p];
+					dstVar[p] = 0;
+					continue;
+				}
+				Centre c = centre(p, step);
+				float lum = luminance(src[p]);
+				float invSigma = 1.0f / (sigma * sqrtf(srcVar[p]) + 1.e-4f);
+				glm::vec3 sum(0);
+				float weightSum = 0, varSum = 0;
+				for (int dy = -2; dy <= 2; dy++)
+				{
+					int y = j + dy * step;
+					if (y < 0 || y >= n) continue;
+					for (int dx = -2; dx <= 2; dx++)
+					{
+						int x = i + dx * step;
+						if (x < 0 || x >= n) continue;
+						int q = y * n + x;
+						if (depth[q] == 0) continue;
+						float w = KERNEL[abs(dx)] * KERNEL[abs(dy)]
+							* featureWeight(c, q, fabsf(lum - luminance(src[q])) * invSigma);
+						sum += w * src[q];
+						weightSum += w;
+						varSum += w * w * srcVar[q];
+					}
+				}
+				dst[p] = sum / weightSum; // The centre tap always has weight > 0
+				dstVar[p] = varSum / (weightSum * weightSum);
+			}
+		}
+	});
+}
+
+/**
+* Denoises the colour of 'frame' in place.
+*/
+void Denoiser::denoise(FrameBuffer& frame)
+{
+	if (strength <= 0 || !frame.has(CHANNELS)) return;
+	int n = camera.getNumDiv();
+	features = &frame;
+	demodulationAlbedo();
+
+	// Filter the illumination: colour divided by albedo
+	std::vector<glm::vec3> a(n * n), b(n * n);
+	std::vector<float> varA(n * n), varB(n * n);
+	parallelFor(n, [&](int j) {
+		for (int p = j * n; p < (j + 1) * n; p++)
+		{
+			a[p] = frame.color[p] / glm::max(albedo[p], glm::vec3(ALBEDO_MIN));
+		}
+	});
+	estimateVariance(a, varA);
+
+	for (int k = 0; k < ITERATIONS; k++)
+	{
+		filterPass(a, varA, b, varB, 1 << k);
+		std::swap(a, b);
+		std::swap(varA, varB);
+	}
+
+	parallelFor(n, [&](int j) {
+		for (int p = j * n; p < (j + 1) * n; p++)
+		{
+			if (frame.depth[p] > 0) frame.color[p] = a[p] * glm::max(albedo[p], glm::vec3(ALBEDO_MIN));
+		}
+	});
+}
+
+void Denoiser::setStrength(float s)
+{
+	strength = std::max(s, 0.0f);
+}
+
+float Denoiser::getStrength()
+{
+	return strength;
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#ifndef H_DENOISER
+#define H_DENOISER
+#include <glm/glm.hpp>
+#include <vector>
+#include "Scene.h"
+#include "Camera.h"
+#include "FrameBuffer.h"
+
+/**
+ * Edge-aware denoiser for finished frames (an edge-avoiding a-trous wavelet filter).
+ * The colour is divided by the albedo of the primary hit, smoothed by repeated 5x5
+ * B-spline passes whose taps are spread 1, 2, 4, ... pixels apart, and multiplied
+ * by the albedo again, so textures stay sharp. Every tap is weighted by how much its
+ * normal, depth, albedo and luminance differ from those of the centre pixel, which
+ * keeps object edges and shadow boundaries. Luminance differences are measured in
+ * standard deviations of the noise, estimated from the neighbourhood of each pixel
+ * and carried through the passes. The features come from the AOV channels of the
+ * frame, which must include CHANNELS.
+ */
+class Denoiser
+{
+
+private:
+	static const int TILE_SIZE = 32;
+	static const int ITERATIONS = 5; // Widest tap spacing 2^(ITERATIONS-1) pixels
+
+	Scene& scene;
+	Camera& camera;
+	float strength = 1.0;
+	const FrameBuffer* features = nullptr; // Frame being denoised
+	std::vector<glm::vec3> albedo; // Albedo the colour is divided by
+
+	struct Centre
+	{
+		glm::vec3 normal, albedo;
+		float depth;
+		float invDepthScale; // Inverse of the depth difference tolerated at the tap spacing
+	};
+
+	void demodulationAlbedo();
+	Centre centre(int p, int step);
+	float featureWeight(const Centre& c, int q, float exponent);
+	void estimateVariance(const std::vector<glm::vec3>& src, std::vector<float>& var);
+	void filterPass(const std::vector<glm::vec3>& src, const std::vector<float>& srcVar,
+		std::vector<glm::vec3>& dst, std::vector<float>& dstVar, int step);
+
+public:
+	static const unsigned int CHANNELS = AOV_DEPTH | AOV_NORMAL | AOV_ALBEDO | AOV_OBJECT_ID;
+
+	Denoiser(Scene& s, Camera& c) : scene(s), camera(c) {}
+
+	void denoise(FrameBuffer& frame);
+
+	/**
+	 * Sets how strongly luminance differences are smoothed over (default 1); 0
+	 * disables the filter.
+	 */
+	void setStrength(float s);
+
+	float getStrength();
+
+};
+
+#endif //!H_DENOISER
@@ -0,0 +1,20 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "DirectionalLight.h"
+
+glm::vec3 DirectionalLight::illuminate(glm::vec3 p, glm::vec3& lightVec, float& lightDist)
+{
+	lightVec = -direction;
+	lightDist = 1.e+6; // Beyond every object in the scene
+	return intensity_ * color_;
+}
+
+bool DirectionalLight::emissionBounds(glm::vec3& pos, glm::vec3& axis, float& thetaO, float& thetaE)
+{
+	return false;
+}
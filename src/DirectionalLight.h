@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#ifndef H_DIRLIGHT
+#define H_DIRLIGHT
+#include <glm/glm.hpp>
+#include "Light.h"
+
+/**
+ * Defines a distant light whose parallel rays travel along 'direction'.
+ * The influence radius does not apply to directional lights.
+ */
+class DirectionalLight : public Light
+{
+
+private:
+	glm::vec3 direction = glm::vec3(0, -1, 0);
+
+public:
+	DirectionalLight() {};
+
+	DirectionalLight(glm::vec3 dir) : direction(glm::normalize(dir)) {}
+
+	glm::vec3 illuminate(glm::vec3 p, glm::vec3& lightVec, float& lightDist);
+
+	bool emissionBounds(glm::vec3& pos, glm::vec3& axis, float& thetaO, float& thetaE);
+
+};
+
+#endif //!H_DIRLIGHT
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "DiskLight.h"
+#include <math.h>
+
+DiskLight::DiskLight(glm::vec3 c, glm::vec3 n, float r) : AreaLight(c), diskRadius(r)
+{
+	n = glm::normalize(n);
+	normal = n;
+	glm::vec3 a = (fabs(n.x) > 0.9) ? glm::vec3(0, 1, 0) : glm::vec3(1, 0, 0);
+	tangent = glm::normalize(glm::cross(a, n));
+	bitangent = glm::cross(n, tangent);
+}
+
+/**
+* Uses the concentric mapping of the unit square onto the disk, which keeps
+* stratified samples evenly spread over the disk.
+*/
+glm::vec3 DiskLight::samplePoint(float u, float v)
+{
+	const float PI = 3.14159265f;
+	float a = 2 * u - 1;
+	float b = 2 * v - 1;
+	float r, phi;
+	if (a == 0 && b == 0) return position;
+	if (fabs(a) > fabs(b)) {
+		r = a;
+		phi = (PI / 4) * (b / a);
+	}
+	else {
+		r = b;
+		phi = (PI / 2) - (PI / 4) * (a / b);
+	}
+	r *= diskRadius;
+	return position + r * cosf(phi) * tangent + r * sinf(phi) * bitangent;
+}
+
+float DiskLight::intersect(glm::vec3 p0, glm::vec3 dir)
+{
+	float d_dot_n = glm::dot(dir, normal);
+	if (fabs(d_dot_n) < 1.e-4) return -1; // Parallel ray
+	float t = glm::dot(position - p0, normal) / d_dot_n;
+	if (t < 0) return -1;
+	glm::vec3 q = p0 + dir * t - position;
+	if (glm::dot(q, q) > diskRadius * diskRadius) return -1;
+	return t;
+}
+
+glm::vec3 DiskLight::surfaceNormal(glm::vec3 x)
+{
+	return normal;
+}
+
+float DiskLight::area()
+{
+	const float PI = 3.14159265f;
+	return PI * diskRadius * diskRadius;
+}
@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#ifndef H_DISKLIGHT
+#define H_DISKLIGHT
+#include <glm/glm.hpp>
+#include "AreaLight.h"
+
+/**
+ * Defines a disk shaped light centered at 'position', perpendicular
+ * to 'normal' and with the specified radius.
+ */
+class DiskLight : public AreaLight
+{
+
+private:
+	glm::vec3 tangent = glm::vec3(1, 0, 0); // Orthonormal basis of the plane of the disk
+	glm::vec3 bitangent = glm::vec3(0, 0, 1);
+	glm::vec3 normal = glm::vec3(0, 1, 0);
+	float diskRadius = 1;
+
+public:
+	DiskLight() {};
+
+	DiskLight(glm::vec3 c, glm::vec3 n, float r);
+
+	glm::vec3 samplePoint(float u, float v);
+
+	float intersect(glm::vec3 p0, glm::vec3 dir);
+
+	glm::vec3 surfaceNormal(glm::vec3 x);
+
+	float area();
+
+};
+
+#endif //!H_DISKLIGHT
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "FrameBuffer.h"
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+	// Writes one channel as a PFM file: "PF" (3 floats per pixel) or "Pf" (1 float),
+	// little endian (negative scale), rows from the bottom up.
+	bool writePFM(const std::string& filename, const float* data, int width, int height, int components)
+	{
+		std::ofstream file(filename, std::ios::out | std::ios::binary);
+		if (!file) return false;
+		file << (components == 3 ? "PF" : "Pf") << "\n" << width << " " << height << "\n-1.0\n";
+		file.write((const char*)data, sizeof(float) * width * height * components);
+		return (bool)file;
+	}
+}
+
+void FrameBuffer::resize(int w, int h, unsigned int aovs)
+{
+	width = w;
+	height = h;
+	channels = aovs;
+	int size = w * h;
+	color.resize(size);
+	depth.assign(has(AOV_DEPTH) ? size : 0, 0.0f);
+	normal.assign(has(AOV_NORMAL) ? size : 0, glm::vec3(0));
+	albedo.assign(has(AOV_ALBEDO) ? size : 0, glm::vec3(0));
+	objectId.assign(has(AOV_OBJECT_ID) ? size : 0, -1);
+	position.assign(has(AOV_POSITION) ? size : 0, glm::vec3(0));
+	motion.assign(has(AOV_MOTION) ? size : 0, glm::vec2(0));
+}
+
+bool FrameBuffer::has(unsigned int aovs) const
+{
+	return (channels & aovs) == aovs;
+}
+
+unsigned int FrameBuffer::getChannels() const
+{
+	return channels;
+}
+
+void FrameBuffer::writeHit(int pixel, Scene& scene, const Ray& ray)
+{
+	if (ray.index == -1) return; // Background: left as cleared
+	SceneObject* obj = scene.objects[ray.index];
+	if (has(AOV_DEPTH)) depth[pixel] = ray.dist;
+	if (has(AOV_NORMAL)) {
+		glm::vec3 normalVec = obj->normal(ray.hit);
+		normal[pixel] = glm::dot(normalVec, ray.dir) > 0 ? -normalVec : normalVec;
+	}
+	if (has(AOV_ALBEDO)) albedo[pixel] = scene.surfaceColor(ray.index, scene.textureCoords(ray.index, ray.hit));
+	if (has(AOV_OBJECT_ID)) objectId[pixel] = ray.index;
+	if (has(AOV_POSITION)) position[pixel] = ray.hit;
+}
+
+bool FrameBuffer::save(const std::string& prefix) const
+{
+	bool ok = writePFM(prefix + ".color.pfm", &color[0].x, width, height, 3);
+	if (has(AOV_DEPTH)) ok &= writePFM(prefix + ".depth.pfm", depth.data(), width, height, 1);
+	if (has(AOV_NORMAL)) ok &= writePFM(prefix + ".normal.pfm", &normal[0].x, width, height, 3);
+	if (has(AOV_ALBEDO)) ok &= writePFM(prefix + ".albedo.pfm", &albedo[0].x, width, height, 3);
+	if (has(AOV_OBJECT_ID)) {
+		std::vector<float> ids(objectId.begin(), objectId.end());
+		ok &= writePFM(prefix + ".id.pfm", ids.data(), width, height, 1);
+	}
+	if (has(AOV_POSITION)) ok &= writePFM(prefix + ".position.pfm", &position[0].x, width, height, 3);
+	if (has(AOV_MOTION)) {
+		std::vector<glm::vec3> vectors(motion.size());
+		for (size_t p = 0; p < motion.size(); p++) vectors[p] = glm::vec3(motion[p], 0);
+		ok &= writePFM(prefix + ".motion.pfm", &vectors[0].x, width, height, 3);
+	}
+	return ok;
+}
+
+unsigned int FrameBuffer::parseChannels(const std::string& names)
+{
+	unsigned int aovs = 0;
+	std::stringstream list(names);
+	std::string name;
+	while (std::getline(list, name, ','))
+	{
+		if (name == "depth") aovs |= AOV_DEPTH;
+		else if (name == "normal") aovs |= AOV_NORMAL;
+		else if (name == "albedo") aovs |= AOV_ALBEDO;
+		else if (name == "id") aovs |= AOV_OBJECT_ID;
+		else if (name == "position") aovs |= AOV_POSITION;
+		else if (name == "motion") aovs |= AOV_MOTION;
+		else if (name == "all") aovs |= AOV_ALL;
+	}
+	return aovs;
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#ifndef H_FRAMEBUFFER
+#define H_FRAMEBUFFER
+#include <glm/glm.hpp>
+#include <vector>
+#include <string>
+#include "Scene.h"
+#include "Ray.h"
+
+/**
+ * Arbitrary output variables: per-pixel data about the primary hit that can be
+ * stored alongside the colour. Flags, combined with |.
+ */
+enum AOV
+{
+	AOV_DEPTH = 1, // Distance from the camera to the primary hit
+	AOV_NORMAL = 2, // World space unit normal, facing the camera
+	AOV_ALBEDO = 4, // Surface colour (including textures) without lighting
+	AOV_OBJECT_ID = 8, // Index of the object in the scene
+	AOV_POSITION = 16, // World space position of the primary hit
+	AOV_MOTION = 32, // Screen space motion since the previous frame, in pixels (temporal mode)
+	AOV_ALL = 63
+};
+
+/**
+ * Multi-channel frame: the colour of every pixel plus the enabled AOV channels,
+ * all row major starting from the bottom left pixel. The AOVs describe the hit of
+ * the primary ray through the centre of each cell; renderers record them from the
+ * rays they trace anyway (those with jittered primary rays trace one more, at the
+ * centre). Pixels where the primary ray misses the scene have depth 0 and object
+ * ID -1.
+ */
+class FrameBuffer
+{
+
+private:
+	int width = 0;
+	int height = 0;
+	unsigned int channels = 0; // Enabled AOVs
+
+public:
+	std::vector<glm::vec3> color;
+	std::vector<float> depth;
+	std::vector<glm::vec3> normal;
+	std::vector<glm::vec3> albedo;
+	std::vector<int> objectId;
+	std::vector<glm::vec3> position;
+	std::vector<glm::vec2> motion;
+
+	/**
+	 * Sizes the colour and the AOV channels in 'aovs' for a frame of w x h pixels.
+	 * The AOVs are cleared to the background.
+	 */
+	void resize(int w, int h, unsigned int aovs);
+
+	bool has(unsigned int aovs) const;
+
+	unsigned int getChannels() const;
+
+	/**
+	 * Stores the AOVs of pixel 'pixel' from its primary ray 'ray', after the ray
+	 * has been intersected with the scene.
+	 */
+	void writeHit(int pixel, Scene& scene, const Ray& ray);
+
+	/**
+	 * Writes the colour and every enabled AOV to its own PFM (portable float map)
+	 * file, named 'prefix' followed by ".color.pfm", ".depth.pfm" and so on.
+	 * Returns false if a file could not be written.
+	 */
+	bool save(const std::string& prefix) const;
+
+	/**
+	 * Parses a comma separated list of AOV names (depth, normal, albedo, id,
+	 * position, motion or all) into a set of AOV flags.
+	 */
+	static unsigned int parseChannels(const std::string& names);
+
+};
+
+#endif //!H_FRAMEBUFFER
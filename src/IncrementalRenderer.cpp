@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "IncrementalRenderer.h"
+#include "Parallel.h"
+#include <algorithm>
+
+
+/**
+* Renders one tile into the kept frame and records the objects its rays meet.
+*/
+void IncrementalRenderer::renderTile(int tile, const PixelFunction& pixel)
+{
+	int n = camera.getNumDiv();
+	int tilesX = (n + TILE_SIZE - 1) / TILE_SIZE;
+	int x0 = (tile % tilesX) * TILE_SIZE, y0 = (tile / tilesX) * TILE_SIZE;
+	FrameBuffer* aovs = image.getChannels() != 0 ? &image : nullptr;
+
+	dependencies[tile].assign(scene.objects.size(), false);
+	Ray::touched = &dependencies[tile];
+	for (int j = y0; j < std::min(y0 + TILE_SIZE, n); j++)
+	{
+		for (int i = x0; i < std::min(x0 + TILE_SIZE, n); i++)
+		{
+			image.color[j * n + i] = pixel(i, j, aovs);
+		}
+	}
+	Ray::touched = nullptr;
+	dirty[tile] = false;
+}
+
+/**
+* Renders the dirty tiles in parallel and copies the kept frame into 'fb', whose
+* size and channels must already be set.
+*/
+void IncrementalRenderer::render(FrameBuffer& fb, const PixelFunction& pixel)
+{
+	int n = camera.getNumDiv();
+	int tilesX = (n + TILE_SIZE - 1) / TILE_SIZE;
+	int tiles = tilesX * tilesX;
+
+	if (image.color.size() != n * n || image.getChannels() != fb.getChannels()) {
+		image.resize(n, n, fb.getChannels());
+		dirty.assign(tiles, true);
+		dependencies.assign(tiles, std::vector<bool>());
+	}
+	if (renderedEye != camera.getEye()) invalidateAll();
+	for (const std::vector<bool>& objects : dependencies)
+	{
+		if (!objects.empty() && objects.size() != scene.objects.size()) {
+			invalidateAll();
+			break;
+		}
+	}
+
+	std::vector<int> work;
+	for (int t = 0; t < tiles; t++)
+	{
+		if (dirty[t]) work.push_back(t);
+	}
+	parallelFor(work.size(), [&](int k) { renderTile(work[k], pixel); });
+	renderedTiles = work.size();
+	renderedEye = camera.getEye();
+	fb = image;
+}
+
+void IncrementalRenderer::invalidate(int object)
+{
+	for (size_t t = 0; t < dependencies.size(); t++)
+	{
+		if (object >= 0 && (size_t)object < dependencies[t].size() && dependencies[t][object]) dirty[t] = true;
+	}
+}
+
+void IncrementalRenderer::invalidateAll()
+{
+	dirty.assign(dirty.size(), true);
+}
+
+int IncrementalRenderer::getRenderedTiles()
+{
+	return renderedTiles;
+}
+
+int IncrementalRenderer::getTileCount()
+{
+	return dirty.size();
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#ifndef H_INCREMENTAL
+#define H_INCREMENTAL
+#include <glm/glm.hpp>
+#include <vector>
+#include <functional>
+#include "Scene.h"
+#include "Camera.h"
+#include "FrameBuffer.h"
+
+/**
+ * Keeps the last frame and re-renders only the parts of it that an edit of the
+ * scene can change. The image is split into square tiles, and while a tile is
+ * rendered every object that decides the outcome of one of its rays (the closest
+ * hit of a primary, reflected or refracted ray, the blockers of a shadow ray and
+ * the occluder of an ambient occlusion ray) is added to the tile's dependency set.
+ * After an edit of an object, only the tiles whose set holds it are rendered again.
+ *
+ * The sets are exact for material edits. Objects cannot be moved in this tree; a
+ * moved object would also change tiles whose rays it did not meet before. The
+ * caustic map is not rebuilt: call invalidateAll() after rebuilding it. Moving the
+ * camera or changing the number of objects or the AOV channels re-renders everything.
+ */
+class IncrementalRenderer
+{
+
+public:
+	/**
+	 * Returns the colour of cell (i, j) and records its AOVs in 'aovs', if given.
+	 */
+	typedef std::function<glm::vec3(int i, int j, FrameBuffer* aovs)> PixelFunction;
+
+private:
+	static const int TILE_SIZE = 16;
+
+	Scene& scene;
+	Camera& camera;
+	FrameBuffer image; // Last frame, before any post-processing
+	std::vector<std::vector<bool>> dependencies; // Objects met by the rays of each tile
+	std::vector<bool> dirty;
+	glm::vec3 renderedEye = glm::vec3(0);
+	int renderedTiles = 0; // Tiles rendered by the last call of render()
+
+	void renderTile(int tile, const PixelFunction& pixel);
+
+public:
+	IncrementalRenderer(Scene& s, Camera& c) : scene(s), camera(c) {}
+
+	/**
+	 * Brings 'fb' up to date with the scene: renders the tiles changed since the last
+	 * call (all of them the first time) and copies the rest from the last frame.
+	 */
+	void render(FrameBuffer& fb, const PixelFunction& pixel);
+
+	/**
+	 * Marks the tiles that depend on the object with the given index for rendering.
+	 */
+	void invalidate(int object);
+
+	void invalidateAll();
+
+	int getRenderedTiles();
+
+	int getTileCount();
+
+};
+
+#endif //!H_INCREMENTAL
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "IrradianceCache.h"
+#include <math.h>
+#include <algorithm>
+
+const float MIN_RADIUS = 0.5f; // Record radii are clamped to this range (scene units)
+const float MAX_RADIUS = 20.0f;
+
+IrradianceCache::IrradianceCache()
+{
+	cellSize = accuracy * MAX_RADIUS;
+}
+
+long long IrradianceCache::cellKey(int x, int y, int z)
+{
+	return ((long long)(x & 0xFFFFF) << 40) | ((long long)(y & 0xFFFFF) << 20) | (long long)(z & 0xFFFFF);
+}
+
+/**
+* Adds a record (its radius already clamped) and registers it in the cells
+* overlapped by its validity region.
+*/
+void IrradianceCache::insert(IrradianceRecord record)
+{
+	int index = records.size();
+	records.push_back(record);
+	float reach = accuracy * record.radius;
+	glm::ivec3 lo(glm::floor((record.position - reach) / cellSize));
+	glm::ivec3 hi(glm::floor((record.position + reach) / cellSize));
+	for (int z = lo.z; z <= hi.z; z++)
+	for (int y = lo.y; y <= hi.y; y++)
+	for (int x = lo.x; x <= hi.x; x++)
+	{
+		cells[cellKey(x, y, z)].push_back(index);
+	}
+}
+
+/**
+* Blends the records valid at 'p' (normal 'n'). Returns false when there are none.
+*/
+bool IrradianceCache::interpolate(glm::vec3 p, glm::vec3 n, glm::vec3& irradiance)
+{
+	glm::ivec3 cell(glm::floor(p / cellSize));
+	auto it = cells.find(cellKey(cell.x, cell.y, cell.z));
+	if (it == cells.end()) return false;
+
+	glm::vec3 sum(0);
+	float weightSum = 0;
+	for (int index : it->second)
+	{
+		const IrradianceRecord& rec = records[index];
+		glm::vec3 d = p - rec.position;
+		float nDotn = std::min(1.0f, glm::dot(n, rec.normal));
+		if (nDotn <= 0) continue;
+		float error = glm::length(d) / rec.radius + sqrtf(1 - nDotn);
+		if (error >= accuracy) continue;
+		if (glm::dot(d, rec.normal + n) < -0.1f * rec.radius) continue; // Record lies in front of p
+
+		float w = 1 / std::max(error, 1.e-4f);
+		glm::vec3 e = rec.irradiance + glm::cross(rec.normal, n) * rec.rotGradient + d * rec.transGradient;
+		sum += w * glm::max(e, glm::vec3(0));
+		weightSum += w;
+	}
+	if (weightSum <= 0) return false;
+	irradiance = sum / weightSum;
+	return true;
+}
+
+void IrradianceCache::clear()
+{
+	records.clear();
+	cells.clear();
+}
+
+void IrradianceCache::setAccuracy(float a)
+{
+	accuracy = std::max(0.01f, a);
+	cellSize = accuracy * MAX_RADIUS;
+	clear();
+}
+
+float IrradianceCache::getMinRadius()
+{
+	return MIN_RADIUS;
+}
+
+float IrradianceCache::getMaxRadius()
+{
+	return MAX_RADIUS;
+}
+
+int IrradianceCache::size()
+{
+	return records.size();
+}
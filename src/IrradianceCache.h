@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#ifndef H_IRRADIANCECACHE
+#define H_IRRADIANCECACHE
+#include <glm/glm.hpp>
+#include <vector>
+#include <unordered_map>
+
+/**
+ * Indirect irradiance sampled over the hemisphere at one surface point. The
+ * irradiance is stored divided by pi, so a diffuse surface of colour 'col'
+ * reflects col * irradiance. The gradients hold one column per colour channel.
+ */
+struct IrradianceRecord
+{
+	glm::vec3 position;
+	glm::vec3 normal;
+	glm::vec3 irradiance;
+	glm::mat3 rotGradient; // Change with the rotation of the normal
+	glm::mat3 transGradient; // Change with the position
+	float radius; // Harmonic mean distance to the surrounding surfaces
+};
+
+/**
+ * Sparse irradiance records with Ward's error metric: a record is used at points
+ * within 'accuracy' times its radius whose normal is similar, and the records
+ * found are blended with gradient extrapolation. Records are registered in every
+ * cell of a hashed grid that their validity region overlaps, so a lookup only
+ * reads the cell of the query point.
+ */
+class IrradianceCache
+{
+
+private:
+	std::vector<IrradianceRecord> records;
+	std::unordered_map<long long, std::vector<int>> cells;
+	float accuracy = 0.3f;
+	float cellSize;
+
+	long long cellKey(int x, int y, int z);
+
+public:
+	IrradianceCache();
+
+	void insert(IrradianceRecord record);
+
+	bool interpolate(glm::vec3 p, glm::vec3 n, glm::vec3& irradiance);
+
+	void clear();
+
+	void setAccuracy(float a);
+
+	float getMinRadius();
+
+	float getMaxRadius();
+
+	int size();
+
+};
+
+#endif //!H_IRRADIANCECACHE
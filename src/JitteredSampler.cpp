@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "JitteredSampler.h"
+#include <math.h>
+
+namespace
+{
+	// Element 'i' of a random permutation of [0, n) chosen by 'seed' (Kensler,
+	// "Correlated Multi-Jittered Sampling").
+	unsigned int permute(unsigned int i, unsigned int n, unsigned int seed)
+	{
+		unsigned int w = n - 1;
+		w |= w >> 1; w |= w >> 2; w |= w >> 4; w |= w >> 8; w |= w >> 16;
+		do
+		{
+			i ^= seed; i *= 0xe170893d; i ^= seed >> 16;
+			i ^= (i & w) >> 4; i ^= seed >> 8; i *= 0x0929eb3f;
+			i ^= seed >> 23; i ^= (i & w) >> 1; i *= 1 | seed >> 27;
+			i *= 0x6935fa69; i ^= (i & w) >> 11; i *= 0x74dcb303;
+			i ^= (i & w) >> 2; i *= 0x9e501cc3; i ^= (i & w) >> 2;
+			i *= 0xc860a3df; i &= w; i ^= i >> 5;
+		} while (i >= n);
+		return (i + seed) % n;
+	}
+}
+
+glm::vec2 JitteredSampler::get2D(glm::ivec2 pixel, int index, int count, int dim)
+{
+	int nx = (int)ceilf(sqrtf((float)count));
+	int ny = (count + nx - 1) / nx;
+	unsigned int seed = hash(pixel.x, pixel.y, dim);
+	unsigned int cell = permute(index % (nx * ny), nx * ny, seed);
+	float jx = toFloat(hash(seed, index, 1));
+	float jy = toFloat(hash(seed, index, 2));
+	return glm::vec2(((cell % nx) + jx) / nx, ((cell / nx) + jy) / ny);
+}
@@ -0,0 +1,27 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#ifndef H_JITTEREDSAMPLER
+#define H_JITTEREDSAMPLER
+#include "Sampler.h"
+
+/**
+ * Stratified sampling: the unit square is divided into about 'count' equal cells
+ * and each sample is placed at random within its own cell. The cells are visited
+ * in a random order per pixel and dimension.
+ */
+class JitteredSampler : public Sampler
+{
+
+public:
+	JitteredSampler() {}
+
+	glm::vec2 get2D(glm::ivec2 pixel, int index, int count, int dim);
+
+};
+
+#endif //!H_JITTEREDSAMPLER
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "LatticeSampler.h"
+#include <math.h>
+#include <algorithm>
+
+std::vector<int> LatticeSampler::generators;
+
+namespace
+{
+	// Greatest common divisor (Euclid), as std::gcd needs C++17
+	int gcd(int a, int b)
+	{
+		while (b != 0)
+		{
+			int r = a % b;
+			a = b;
+			b = r;
+		}
+		return a;
+	}
+}
+
+LatticeSampler::LatticeSampler()
+{
+	if (generators.empty()) buildTable();
+}
+
+/**
+* For every set size n, tries all generators g coprime to n. As the points form a
+* lattice, the smallest distance between any two points is the smallest distance
+* of a point from the origin (on the torus).
+*/
+void LatticeSampler::buildTable()
+{
+	generators.assign(MAX_TABLE + 1, 1);
+	for (int n = 2; n <= MAX_TABLE; n++)
+	{
+		float bestDist = -1;
+		for (int g = 1; g < n; g++)
+		{
+			if (gcd(g, n) != 1) continue;
+			float minDist = 1.e30f;
+			for (int i = 1; i < n; i++)
+			{
+				float x = (float)i / n, y = (float)((long long)i * g % n) / n;
+				x = std::min(x, 1 - x);
+				y = std::min(y, 1 - y);
+				minDist = std::min(minDist, x * x + y * y);
+			}
+			if (minDist > bestDist) {
+				bestDist = minDist;
+				generators[n] = g;
+			}
+		}
+	}
+}
+
+int LatticeSampler::generator(int count)
+{
+	if (count <= MAX_TABLE) return generators[count];
+	int g = (int)lround(count * 0.6180339887);
+	while (gcd(g, count) != 1) g++;
+	return g;
+}
+
+glm::vec2 LatticeSampler::get2D(glm::ivec2 pixel, int index, int count, int dim)
+{
+	unsigned int seed = hash(pixel.x, pixel.y, dim);
+	int g = generator(count);
+	float u = (float)(index % count) / count + toFloat(hash(seed, 1, 0));
+	float v = (float)((long long)(index % count) * g % count) / count + toFloat(hash(seed, 2, 0));
+	return glm::vec2(u - floorf(u), v - floorf(v));
+}
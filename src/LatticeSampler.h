@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#ifndef H_LATTICESAMPLER
+#define H_LATTICESAMPLER
+#include <vector>
+#include "Sampler.h"
+
+/**
+ * Rank-1 lattice: the 'count' points (i / count) * (1, g) modulo 1, randomly
+ * shifted per pixel and dimension. The generator g that maximises the smallest
+ * distance between points is found once for every set size up to MAX_TABLE;
+ * larger sets use the Fibonacci-like g closest to count / golden ratio.
+ */
+class LatticeSampler : public Sampler
+{
+
+private:
+	static const int MAX_TABLE = 256;
+	static std::vector<int> generators;
+
+	static void buildTable();
+	static int generator(int count);
+
+public:
+	LatticeSampler();
+
+	glm::vec2 get2D(glm::ivec2 pixel, int index, int count, int dim);
+
+};
+
+#endif //!H_LATTICESAMPLER
@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "Light.h"
+
+/**
+* Smooth window that fades the light out to zero at its influence radius.
+*/
+float Light::attenuation(float dist)
+{
+	if (radius_ <= 0) return 1;
+	float x = dist / radius_;
+	float w = 1 - x * x * x * x;
+	if (w <= 0) return 0;
+	return w * w;
+}
+
+/**
+* Returns the total strength of the light, used to weight it against other lights.
+*/
+float Light::power()
+{
+	glm::vec3 col = intensity_ * color_;
+	return 0.2126f * col.r + 0.7152f * col.g + 0.0722f * col.b;
+}
+
+glm::vec3 Light::getColor()
+{
+	return color_;
+}
+
+float Light::getIntensity()
+{
+	return intensity_;
+}
+
+float Light::getRadius()
+{
+	return radius_;
+}
+
+void Light::setColor(glm::vec3 col)
+{
+	color_ = col;
+}
+
+void Light::setIntensity(float intensity)
+{
+	intensity_ = intensity;
+}
+
+void Light::setRadius(float radius)
+{
+	radius_ = radius;
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#ifndef H_LIGHT
+#define H_LIGHT
+#include <glm/glm.hpp>
+
+/**
+ * Base class of all light sources. A light has a colour, an intensity and an
+ * optional influence radius beyond which it contributes nothing.
+ */
+class Light
+{
+protected:
+	glm::vec3 color_ = glm::vec3(1); // Light color
+	float intensity_ = 1.0; // Scale applied to the light color
+	float radius_ = 0; // Influence radius (0 = unlimited)
+
+	float attenuation(float dist);
+
+public:
+	Light() {}
+	virtual ~Light() {}
+
+	/**
+	 * Computes the unit vector from 'p' towards the light and the distance to it,
+	 * and returns the light arriving at 'p' when nothing blocks it.
+	 */
+	virtual glm::vec3 illuminate(glm::vec3 p, glm::vec3& lightVec, float& lightDist) = 0;
+
+	/**
+	 * Describes where and in which directions the light emits: its position, the axis of
+	 * its emission cone, the half angle 'thetaO' bounding the emitting directions around
+	 * the axis and the additional falloff angle 'thetaE' (angles in radians).
+	 * Returns false for lights infinitely far away, which have no position.
+	 */
+	virtual bool emissionBounds(glm::vec3& pos, glm::vec3& axis, float& thetaO, float& thetaE) = 0;
+
+	float power();
+
+	void setColor(glm::vec3 col);
+	void setIntensity(float intensity);
+	void setRadius(float radius);
+	glm::vec3 getColor();
+	float getIntensity();
+	float getRadius();
+};
+
+#endif //!H_LIGHT
@@ -0,0 +1,254 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "LightBVH.h"
+#include <algorithm>
+#include <math.h>
+#include <glm/gtc/constants.hpp>
+
+namespace
+{
+	// Angle between two unit vectors.
+	float angleBetween(glm::vec3 a, glm::vec3 b)
+	{
+		return acos(glm::clamp(glm::dot(a, b), -1.0f, 1.0f));
+	}
+
+	// Rotates the unit vector 'v' by 'angle' towards the unit vector 'w'.
+	glm::vec3 rotateTowards(glm::vec3 v, glm::vec3 w, float angle)
+	{
+		glm::vec3 perp = w - glm::dot(v, w) * v;
+		float len = glm::length(perp);
+		if (len < 1.e-6) return v;
+		return cos(angle) * v + sin(angle) * (perp / len);
+	}
+}
+
+/**
+* Builds the hierarchy over all lights that have a position. Lights infinitely far
+* away (directional lights) are left out and are returned by getInfiniteLights().
+*/
+void LightBVH::build(std::vector<Light*>& sceneLights)
+{
+	nodes.clear();
+	lights.clear();
+	infiniteLights.clear();
+	leafOf.clear();
+	std::vector<Node> leaves;
+	for (Light* light : sceneLights)
+	{
+		Node leaf;
+		glm::vec3 pos;
+		if (!light->emissionBounds(pos, leaf.axis, leaf.thetaO, leaf.thetaE)) {
+			infiniteLights.push_back(light);
+			continue;
+		}
+		leaf.boundsMin = pos;
+		leaf.boundsMax = pos;
+		leaf.power = light->power();
+		leaf.reach = light->getRadius();
+		leaf.light = lights.size();
+		lights.push_back(light);
+		leaves.push_back(leaf);
+	}
+	if (leaves.empty()) return;
+	nodes.reserve(2 * leaves.size() - 1);
+	build(leaves, 0, leaves.size());
+	for (size_t i = 0; i < nodes.size(); i++)
+	{
+		Node& node = nodes[i];
+		if (node.left >= 0) {
+			nodes[node.left].parent = i;
+			nodes[node.right].parent = i;
+		}
+		else {
+			leafOf[lights[node.light]] = i;
+		}
+		node.cosThetaO = cos(node.thetaO);
+		node.sinThetaO = sin(node.thetaO);
+		node.cosThetaE = cos(node.thetaE);
+	}
+}
+
+/**
+* Recursively builds the subtree over leaves [begin, end) by splitting them at the
+* median along the longest axis of their bounds. Returns the index of the subtree root.
+*/
+int LightBVH::build(std::vector<Node>& leaves, int begin, int end)
+{
+	if (end - begin == 1)
+	{
+		nodes.push_back(leaves[begin]);
+		return nodes.size() - 1;
+	}
+
+	glm::vec3 lo = leaves[begin].boundsMin, hi = leaves[begin].boundsMax;
+	for (int i = begin + 1; i < end; i++)
+	{
+		lo = glm::min(lo, leaves[i].boundsMin);
+		hi = glm::max(hi, leaves[i].boundsMax);
+	}
+	glm::vec3 extent = hi - lo;
+	int dim = (extent.x > extent.y && extent.x > extent.z) ? 0 : (extent.y > extent.z ? 1 : 2);
+	int mid = (begin + end) / 2;
+	std::nth_element(leaves.begin() + begin, leaves.begin() + mid, leaves.begin() + end,
+		[dim](const Node& a, const Node& b) { return a.boundsMin[dim] < b.boundsMin[dim]; });
+
+	int index = nodes.size();
+	nodes.push_back(Node());
+	int left = build(leaves, begin, mid);
+	int right = build(leaves, mid, end);
+	const Node& a = nodes[left];
+	const Node& b = nodes[right];
+
+	Node node;
+	node.boundsMin = glm::min(a.boundsMin, b.boundsMin);
+	node.boundsMax = glm::max(a.boundsMax, b.boundsMax);
+	node.power = a.power + b.power;
+	node.reach = (a.reach <= 0 || b.reach <= 0) ? 0 : std::max(a.reach, b.reach);
+	node.thetaE = std::max(a.thetaE, b.thetaE);
+	node.left = left;
+	node.right = right;
+
+	// Smallest cone containing the emission cones of both children
+	const Node& wide = (a.thetaO >= b.thetaO) ? a : b;
+	const Node& narrow = (a.thetaO >= b.thetaO) ? b : a;
+	float d = angleBetween(wide.axis, narrow.axis);
+	if (std::min(d + narrow.thetaO, glm::pi<float>()) <= wide.thetaO) {
+		node.axis = wide.axis;
+		node.thetaO = wide.thetaO;
+	}
+	else {
+		float thetaO = (wide.thetaO + d + narrow.thetaO) * 0.5f;
+		if (thetaO >= glm::pi<float>()) {
+			node.axis = wide.axis;
+			node.thetaO = glm::pi<float>();
+		}
+		else {
+			node.axis = rotateTowards(wide.axis, narrow.axis, thetaO - wide.thetaO);
+			node.thetaO = thetaO;
+		}
+	}
+
+	nodes[index] = node;
+	return index;
+}
+
+/**
+* Conservative estimate of the light reaching point 'p' with normal 'n' from all lights
+* in 'node': power over squared distance, scaled by upper bounds of the emission and
+* incidence cosines over the bounding box. The angle bounds are evaluated with cosines
+* and sines only, as this runs at every level of the tree for every light sample.
+*/
+float LightBVH::importance(const Node& node, glm::vec3 p, glm::vec3 n)
+{
+	glm::vec3 center = 0.5f * (node.boundsMin + node.boundsMax);
+	float boundRadius = 0.5f * glm::length(node.boundsMax - node.boundsMin);
+	glm::vec3 toCenter = center - p;
+	float dist2 = glm::dot(toCenter, toCenter);
+	float r2 = boundRadius * boundRadius;
+	if (node.reach > 0) {
+		float reach = node.reach + boundRadius;
+		if (dist2 > reach * reach) return 0; // Out of reach of every light
+	}
+	if (dist2 <= r2) return node.power / std::max(dist2, 1.e-4f); // Inside the bounds: no angular bounds apply
+
+	float dist = sqrt(dist2);
+	glm::vec3 dir = toCenter / dist;
+	float sinU = boundRadius / dist; // Half angle subtended by the bounds
+	float cosU = sqrt(1 - sinU * sinU);
+
+	// Emission: angle between the cone axis and the direction towards p, reduced by the
+	// cone angle and the angle subtended by the bounds
+	float cosEmit = 1;
+	if (node.thetaO < glm::pi<float>()) {
+		float cosOU = node.cosThetaO * cosU - node.sinThetaO * sinU; // cos(thetaO + thetaU)
+		float sinOU = node.sinThetaO * cosU + node.cosThetaO * sinU;
+		float cosTheta = glm::dot(node.axis, -dir);
+		bool allDirections = sinOU < 0 || (sinOU == 0 && cosOU < 0); // thetaO + thetaU >= pi
+		if (!allDirections && cosTheta < cosOU) {
+			float sinTheta = sqrt(std::max(0.0f, 1 - cosTheta * cosTheta));
+			cosEmit = cosTheta * cosOU + sinTheta * sinOU;
+			if (cosEmit <= node.cosThetaE) return 0;
+		}
+	}
+
+	// Incidence: angle between the normal and the direction towards the lights
+	float cosI = glm::dot(n, dir);
+	float cosIncident = 1;
+	if (cosI < cosU) {
+		float sinI = sqrt(std::max(0.0f, 1 - cosI * cosI));
+		cosIncident = cosI * cosU + sinI * sinU;
+		if (cosIncident <= 0) return 0;
+	}
+
+	return node.power * cosEmit * cosIncident / std::max(dist2, 0.25f * r2);
+}
+
+/**
+* Picks one light for shading point 'p' with normal 'n' in proportion to its estimated
+* contribution, using the random number 'u' in [0, 1). 'pdf' receives the probability
+* with which the light was chosen. Returns nullptr if no light can contribute.
+*/
+Light* LightBVH::sample(glm::vec3 p, glm::vec3 n, float u, float& pdf)
+{
+	pdf = 0;
+	if (nodes.empty()) return nullptr;
+	int index = 0;
+	float prob = 1;
+	while (nodes[index].left >= 0)
+	{
+		const Node& node = nodes[index];
+		float wl = importance(nodes[node.left], p, n);
+		float wr = importance(nodes[node.right], p, n);
+		if (wl + wr <= 0) return nullptr;
+		float pl = wl / (wl + wr);
+		if (u < pl) {
+			u = std::min(u / pl, 0.99999994f); // Reuse the random number for the next level
+			prob *= pl;
+			index = node.left;
+		}
+		else {
+			u = std::min((u - pl) / (1 - pl), 0.99999994f);
+			prob *= 1 - pl;
+			index = node.right;
+		}
+	}
+	pdf = prob;
+	return lights[nodes[index].light];
+}
+
+/**
+* Returns the probability with which sample() picks 'light' at point 'p' with normal 'n',
+* by walking from the light's leaf up to the root.
+*/
+float LightBVH::pdf(Light* light, glm::vec3 p, glm::vec3 n)
+{
+	auto it = leafOf.find(light);
+	if (it == leafOf.end()) return 0;
+	float prob = 1;
+	for (int child = it->second; nodes[child].parent >= 0; child = nodes[child].parent)
+	{
+		const Node& node = nodes[nodes[child].parent];
+		float wl = importance(nodes[node.left], p, n);
+		float wr = importance(nodes[node.right], p, n);
+		if (wl + wr <= 0) return 0;
+		prob *= ((child == node.left) ? wl : wr) / (wl + wr);
+	}
+	return prob;
+}
+
+std::vector<Light*>& LightBVH::getInfiniteLights()
+{
+	return infiniteLights;
+}
+
+// Number of lights in the hierarchy
+int LightBVH::size()
+{
+	return lights.size();
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#ifndef H_LIGHTBVH
+#define H_LIGHTBVH
+#include <glm/glm.hpp>
+#include <vector>
+#include <unordered_map>
+#include "Light.h"
+
+/**
+ * Bounding volume hierarchy over the lights of a scene. Every node bounds the
+ * positions, the total power and the emission directions of the lights below it,
+ * which gives a conservative estimate of how much the node can contribute at a
+ * shading point. Sampling walks down the tree choosing children in proportion to
+ * that estimate, so picking a light costs O(log n) in the number of lights.
+ */
+class LightBVH
+{
+
+private:
+	struct Node
+	{
+		glm::vec3 boundsMin = glm::vec3(0); // Bounding box of the light positions
+		glm::vec3 boundsMax = glm::vec3(0);
+		glm::vec3 axis = glm::vec3(0, 1, 0); // Bounding cone of the emission directions
+		float thetaO = 0;
+		float thetaE = 0;
+		float cosThetaO = 1; // Cosines and sine of the cone angles, cached for sampling
+		float sinThetaO = 0;
+		float cosThetaE = 1;
+		float power = 0; // Total power of the lights in the node
+		float reach = 0; // Largest influence radius in the node (0 = unlimited)
+		int left = -1; // Index of the first child node, -1 for leaves
+		int right = -1; // Index of the second child node
+		int light = -1; // Index of the light in a leaf
+		int parent = -1; // Index of the parent node, -1 for the root
+	};
+
+	std::vector<Node> nodes;
+	std::vector<Light*> lights;
+	std::vector<Light*> infiniteLights; // Lights without a position, not part of the tree
+	std::unordered_map<Light*, int> leafOf; // Leaf node of every light in the tree
+
+	int build(std::vector<Node>& leaves, int begin, int end);
+	float importance(const Node& node, glm::vec3 p, glm::vec3 n);
+
+public:
+	LightBVH() {}
+
+	void build(std::vector<Light*>& sceneLights);
+
+	Light* sample(glm::vec3 p, glm::vec3 n, float u, float& pdf);
+
+	float pdf(Light* light, glm::vec3 p, glm::vec3 n);
+
+	std::vector<Light*>& getInfiniteLights();
+
+	int size();
+
+};
+
+#endif //!H_LIGHTBVH
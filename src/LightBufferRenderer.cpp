@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "LightBufferRenderer.h"
+#include "Parallel.h"
+
+const int MAX_STEPS = 5; // Same recursion limit as Scene::trace()
+
+
+/**
+* Adds the light seen along 'ray', scaled by 'weight', to the buffers of 'pixel',
+* following the same rules as Scene::trace().
+*/
+void LightBufferRenderer::gather(Ray ray, int step, glm::vec3 weight, int pixel)
+{
+	ray.closestPt(scene.objects);
+	scene.countRay();
+	if (ray.index == -1) return; // Background colour = (0,0,0)
+	SceneObject* obj = scene.objects[ray.index];
+
+	glm::vec3 normalVec = obj->normal(ray.hit);
+	glm::vec3 col = scene.surfaceColor(ray, scene.textureCoords(ray.index, ray.hit), normalVec);
+	float ao = scene.ambientOcclusion(ray.hit, glm::dot(normalVec, ray.dir) > 0 ? -normalVec : normalVec,
+		scene.aoSamples);
+	float t = scene.fogFactor(ray.hit);
+	bool recurse = step < MAX_STEPS;
+	float transmitted = (obj->isTransparent() && recurse) ? 1 - obj->getTransparencyCoeff() : 1;
+
+	// Local shading, fogged and dimmed by transparency
+	glm::vec3 w = weight * ((1 - t) * transmitted);
+	base[pixel] += w * (ao * obj->ambient(col) + scene.caustics(col, ray.hit, normalVec)) + weight * (t * transmitted);
+	for (size_t k = 0; k < scene.lights.size(); k++)
+	{
+		buffers[k][pixel] += w * scene.lightContribution(obj, col, scene.lights[k], ray.hit, -ray.dir, normalVec, 1.0f);
+	}
+
+	if (obj->isReflective() && recurse) {
+		Ray reflectedRay(ray.hit, glm::reflect(ray.dir, normalVec));
+		reflectedRay.reflectDifferentials(ray, obj, normalVec);
+		gather(reflectedRay, step + 1, weight * (obj->getReflectionCoeff() * transmitted), pixel); // Transparency also dims the reflection
+	}
+
+	if (obj->isRefractive() && recurse) {
+		float eta = 1 / obj->getRefractiveIndex();
+		glm::vec3 g = glm::refract(ray.dir, normalVec, eta);
+		Ray refrRay(ray.hit, g);
+		refrRay.refractDifferentials(ray, obj, normalVec, eta);
+		refrRay.closestPt(scene.objects);
+		scene.countRay();
+		glm::vec3 m = obj->normal(refrRay.hit);
+		glm::vec3 h = glm::refract(g, -m, 1.0f / eta);
+		Ray outRay(refrRay.hit, h);
+		outRay.refractDifferentials(refrRay, obj, -m, 1.0f / eta);
+		gather(outRay, step + 1, weight * obj->getRefractionCoeff(), pixel);
+	}
+}
+
+void LightBufferRenderer::render(std::vector<glm::vec3>& frame, FrameBuffer* aovs)
+{
+	int n = camera.getNumDiv();
+	int numLights = scene.lights.size();
+	base.assign(n * n, glm::vec3(0));
+	buffers.resize(numLights);
+	for (std::vector<glm::vec3>& buffer : buffers) buffer.assign(n * n, glm::vec3(0));
+	scales.resize(numLights, glm::vec3(1));
+
+	parallelFor(n, [&](int j) {
+		for (int i = 0; i < n; i++)
+		{
+			Ray ray = camera.primaryRay(i, j);
+			if (aovs != nullptr) {
+				Ray primary = ray;
+				primary.closestPt(scene.objects);
+				aovs->writeHit(j * n + i, scene, primary);
+			}
+			gather(ray, 1, glm::vec3(1), j * n + i);
+		}
+	});
+	relight(frame);
+}
+
+void LightBufferRenderer::relight(std::vector<glm::vec3>& frame)
+{
+	int n = camera.getNumDiv();
+	if (base.size() != n * n) return; // Nothing rendered yet
+	frame.resize(n * n);
+	parallelFor(n, [&](int j) {
+		for (int p = j * n; p < (j + 1) * n; p++)
+		{
+			glm::vec3 color = base[p];
+			for (size_t k = 0; k < buffers.size(); k++) color += scales[k] * buffers[k][p];
+			frame[p] = color;
+		}
+	});
+}
+
+void LightBufferRenderer::setLightScale(int light, glm::vec3 scale)
+{
+	if (light >= 0 && (size_t)light < scales.size()) scales[light] = scale;
+}
+
+glm::vec3 LightBufferRenderer::getLightScale(int light)
+{
+	return (light >= 0 && (size_t)light < scales.size()) ? scales[light] : glm::vec3(0);
+}
+
+int LightBufferRenderer::getLightCount()
+{
+	return scales.size();
+}
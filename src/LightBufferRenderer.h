@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#ifndef H_LIGHTBUFFER
+#define H_LIGHTBUFFER
+#include <glm/glm.hpp>
+#include <vector>
+#include "Scene.h"
+#include "Camera.h"
+#include "FrameBuffer.h"
+
+/**
+ * Whitted renderer that keeps the light of every light source in its own buffer
+ * (per-light AOVs), so that lights can be recoloured and dimmed without tracing
+ * again. The colour of a Whitted frame is linear in the radiance of each light:
+ * reflection, refraction, transparency and fog only scale what reaches the eye.
+ * A pixel is therefore the sum of a base buffer (ambient light, caustics and the
+ * fog colour, which do not depend on the lights) and one buffer per light, each
+ * weighted by the light's colour scale. Recomposing a frame after a change of
+ * scale costs one multiply-add per light and pixel.
+ *
+ * Every light is evaluated at every shading point (no light BVH sampling), so
+ * that each buffer holds the exact contribution of its light. A buffer takes 12
+ * bytes per pixel (3 MB at 500x500), so scenes with more than MAX_LIGHTS lights
+ * are not relit.
+ */
+class LightBufferRenderer
+{
+
+public:
+	static const int MAX_LIGHTS = 32;
+
+private:
+	Scene& scene;
+	Camera& camera;
+	std::vector<glm::vec3> base; // Light that does not depend on the light sources
+	std::vector<std::vector<glm::vec3>> buffers; // Unscaled contribution of each light
+	std::vector<glm::vec3> scales; // Colour scale of each light, (1,1,1) as rendered
+
+	void gather(Ray ray, int step, glm::vec3 weight, int pixel);
+
+public:
+	LightBufferRenderer(Scene& s, Camera& c) : scene(s), camera(c) {}
+
+	/**
+	 * Traces the scene into the light buffers and composes 'frame' (row major,
+	 * starting from the bottom left pixel) from them.
+	 */
+	void render(std::vector<glm::vec3>& frame, FrameBuffer* aovs = nullptr);
+
+	/**
+	 * Composes 'frame' from the light buffers of the last render, with the current
+	 * light scales.
+	 */
+	void relight(std::vector<glm::vec3>& frame);
+
+	void setLightScale(int light, glm::vec3 scale);
+
+	glm::vec3 getLightScale(int light);
+
+	int getLightCount();
+
+};
+
+#endif //!H_LIGHTBUFFER
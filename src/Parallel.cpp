@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "Parallel.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	int threadCount = 0; // 0 = one per hardware thread
+}
+
+void parallelFor(int count, const std::function<void(int)>& body)
+{
+	int threads = getThreadCount();
+	if (threads > count) threads = count;
+	if (threads <= 1) {
+		for (int i = 0; i < count; i++) body(i);
+		return;
+	}
+
+	std::atomic<int> next(0);
+	auto worker = [&]() {
+		for (int i = next++; i < count; i = next++) body(i);
+	};
+	std::vector<std::thread> pool;
+	for (int t = 1; t < threads; t++) pool.emplace_back(worker);
+	worker(); // The calling thread works too
+	for (std::thread& th : pool) th.join();
+}
+
+void setThreadCount(int threads)
+{
+	threadCount = threads;
+}
+
+int getThreadCount()
+{
+	if (threadCount > 0) return threadCount;
+	int hw = std::thread::hardware_concurrency();
+	return hw > 0 ? hw : 1;
+}
@@ -0,0 +1,26 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#ifndef H_PARALLEL
+#define H_PARALLEL
+#include <functional>
+
+/**
+ * Calls 'body' for every index in [0, count) using all render threads. Indices are
+ * handed out one at a time, so the work per index (e.g. an image row or tile)
+ * should be large compared to the cost of fetching it.
+ */
+void parallelFor(int count, const std::function<void(int)>& body);
+
+/**
+ * Sets the number of render threads; 0 uses one thread per hardware thread.
+ */
+void setThreadCount(int threads);
+
+int getThreadCount();
+
+#endif //!H_PARALLEL
@@ -0,0 +1,521 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "PathTracer.h"
+#include "Parallel.h"
+#include <math.h>
+#include <algorithm>
+
+const float PI = 3.14159265f;
+const int MIN_BOUNCES = 3; // Bounces before Russian roulette may end a path
+const int CACHE_SPACING = 32; // Pixel spacing of the first irradiance cache pass, halved in each further pass
+const int CACHE_MIN_SPACING = 4; // Pixel spacing of the last pass
+const int DIMS_PER_BOUNCE = 3; // Sampler dimensions of a path vertex: light point, direction, choices
+const int LIGHT_DIM_STRIDE = 1000; // Dimension offset between the lights sampled at one vertex
+
+namespace
+{
+	// Seed of the random number sequence for one pixel of one frame
+	unsigned int pixelSeed(int pixel, int frame)
+	{
+		unsigned int h = pixel * 0x9E3779B1u ^ (frame + 1) * 0x85EBCA77u;
+		h ^= h >> 16; h *= 0x7FEB352Du;
+		h ^= h >> 15; h *= 0x846CA68Bu;
+		h ^= h >> 16;
+		return h % 2147483646u + 1; // minstd_rand needs a seed in [1, 2^31 - 2]
+	}
+
+	// Cosine-weighted direction in the hemisphere around n
+	glm::vec3 cosineDirection(glm::vec3 n, float u, float v)
+	{
+		float r = sqrtf(u), phi = 2 * PI * v;
+		glm::vec3 t = fabs(n.x) > 0.5f ? glm::vec3(0, 1, 0) : glm::vec3(1, 0, 0);
+		glm::vec3 b1 = glm::normalize(glm::cross(n, t));
+		glm::vec3 b2 = glm::cross(n, b1);
+		return b1 * (r * cosf(phi)) + b2 * (r * sinf(phi)) + n * sqrtf(std::max(0.0f, 1 - u));
+	}
+
+	float powerHeuristic(float pdfA, float pdfB)
+	{
+		return pdfA * pdfA / (pdfA * pdfA + pdfB * pdfB);
+	}
+}
+
+float PathSample::uniform()
+{
+	return std::generate_canonical<float, 24>(rng) * 0.99999994f; // In [0, 1)
+}
+
+glm::vec2 PathSample::get2D(int dim)
+{
+	if (sampler == nullptr) {
+		float u = uniform();
+		return glm::vec2(u, uniform());
+	}
+	return sampler->get2D(pixel, index, count, dim);
+}
+
+/**
+* Diffuse BRDF of a surface with the colour 'col', plus the Phong highlight of
+* the Whitted shading for specular objects. Scaled so that pi * f * cos equals the
+* Whitted diffuse and specular terms for a point light.
+*/
+glm::vec3 PathTracer::brdf(SceneObject* obj, glm::vec3 col, glm::vec3 wi, glm::vec3 wo, glm::vec3 n)
+{
+	glm::vec3 f = col / PI;
+	if (obj->isSpecular()) {
+		float rDotv = glm::dot(glm::reflect(-wi, n), wo);
+		if (rDotv > 0) f += glm::vec3(powf(rDotv, obj->getShininess()) / PI);
+	}
+	return f;
+}
+
+/**
+* Solid angle density with which next-event estimation at 'p' (normal 'n') picks
+* the point 'x' on 'light'.
+*/
+float PathTracer::lightPdf(AreaLight* light, glm::vec3 p, glm::vec3 n, glm::vec3 x)
+{
+	float select = scene.lightTree.size() > 0 ? scene.lightTree.pdf(light, p, n) : 1;
+	glm::vec3 d = x - p;
+	float dist2 = glm::dot(d, d);
+	float cosLight = fabs(glm::dot(light->surfaceNormal(x), d)) / sqrtf(dist2);
+	if (cosLight < 1.e-4) return 0;
+	return select * dist2 / (light->area() * cosLight);
+}
+
+/**
+* Direct light from one light, which was selected with probability 'selectPdf'.
+* 'uv' picks the point on an area light.
+* Area lights are sampled by area and, if 'mis' is set, weighted against BRDF
+* sampling.
+*/
+glm::vec3 PathTracer::sampleLight(Light* light, float selectPdf, SceneObject* obj, glm::vec3 col,
+	glm::vec3 hit, glm::vec3 n, glm::vec3 wo, bool mis, glm::vec2 uv)
+{
+	AreaLight* area = dynamic_cast<AreaLight*>(light);
+	if (area == nullptr) {
+		glm::vec3 lightVec;
+		float lightDist;
+		glm::vec3 radiance = light->illuminate(hit, lightVec, lightDist) / selectPdf;
+		float lDotn = glm::dot(lightVec, n);
+		float visibility = scene.lightVisibility(light, hit, lightVec, lightDist, lDotn, radiance);
+		if (visibility <= 0) return glm::vec3(0);
+		return PI * brdf(obj, col, lightVec, wo, n) * lDotn * radiance * visibility;
+	}
+
+	glm::vec3 x = area->samplePoint(uv.x, uv.y);
+	glm::vec3 d = x - hit;
+	float dist = glm::length(d);
+	glm::vec3 wi = d / dist;
+	float lDotn = glm::dot(wi, n);
+	float cosLight = glm::dot(area->surfaceNormal(x), -wi);
+	if (lDotn <= 0 || (!area->isTwoSided() && cosLight <= 0)) return glm::vec3(0);
+	cosLight = fabs(cosLight);
+	if (cosLight < 1.e-4) return glm::vec3(0);
+
+	float pdf = selectPdf * dist * dist / (area->area() * cosLight);
+	glm::vec3 Le = area->emitted(hit, x);
+	if (std::max(Le.r, std::max(Le.g, Le.b)) <= 0) return glm::vec3(0);
+	float visibility = scene.shadowVisibility(hit, wi, dist);
+	if (visibility <= 0) return glm::vec3(0);
+	float weight = mis ? powerHeuristic(pdf, lDotn / PI) : 1;
+	return brdf(obj, col, wi, wo, n) * Le * (lDotn * weight * visibility / pdf);
+}
+
+/**
+* Next-event estimation: direct light at a diffuse vertex. With a light hierarchy
+* a single positioned light is sampled, otherwise every light. 'dim' is the first
+* sampler dimension of the path vertex.
+*/
+glm::vec3 PathTracer::sampleLights(SceneObject* obj, glm::vec3 col, glm::vec3 hit, glm::vec3 n, glm::vec3 wo,
+	bool mis, PathSample& ps, int dim)
+{
+	glm::vec3 sum(0);
+	if (scene.lightTree.size() > 0) {
+		float pdf;
+		Light* light = scene.lightTree.sample(hit, n, ps.get2D(dim + 2).x, pdf);
+		if (light != nullptr && pdf > 0) sum += sampleLight(light, pdf, obj, col, hit, n, wo, mis, ps.get2D(dim));
+		for (Light* infinite : scene.lightTree.getInfiniteLights())
+		{
+			sum += sampleLight(infinite, 1, obj, col, hit, n, wo, mis, glm::vec2(0));
+		}
+	}
+	else {
+		for (size_t k = 0; k < scene.lights.size(); k++)
+		{
+			sum += sampleLight(scene.lights[k], 1, obj, col, hit, n, wo, mis, ps.get2D(dim + LIGHT_DIM_STRIDE * k));
+		}
+	}
+	return sum;
+}
+
+/**
+* Estimates the radiance arriving along 'ray' with one random path.
+*/
+glm::vec3 PathTracer::radiance(Ray ray, PathSample& ps)
+{
+	glm::vec3 primaryHit;
+	bool hitSurface;
+	glm::vec3 L = tracePath(ray, ps, 0, false, hitSurface, primaryHit);
+	if (!hitSurface) return L;
+	// Clamped fog: radiance above one would turn negative beyond the far end of the fog
+	float t = std::min(scene.fogFactor(primaryHit), 1.0f);
+	return (1 - t) * L + glm::vec3(t);
+}
+
+/**
+* Follows one random path from 'ray', whose origin is vertex 'firstBounce' of the
+* path. A gather path (for an irradiance record) only collects indirect light:
+* emitters it reaches directly are left to next-event estimation at its origin.
+* Returns whether a surface was hit and where in 'hitSurface' and 'firstHit'.
+*/
+glm::vec3 PathTracer::tracePath(Ray ray, PathSample& ps, int firstBounce, bool gather,
+	bool& hitSurface, glm::vec3& firstHit)
+{
+	glm::vec3 L(0);
+	glm::vec3 beta(1); // Path throughput
+	hitSurface = false;
+	bool direct = gather; // Gather ray not yet scattered: emitters it finds are direct light
+	bool specularBounce = true; // Light hit after a specular bounce (or by the camera ray) is not MIS weighted
+	bool causticPath = false; // Specular bounce after a diffuse vertex: light found this way is in the caustic map
+	bool useCache = !gather && irradianceCaching && cache.size() > 0;
+	float bsdfPdf = 0;
+	glm::vec3 prevHit, prevNormal;
+
+	for (int bounce = firstBounce; ; bounce++)
+	{
+		ray.closestPt(scene.objects);
+		scene.countRay();
+
+		// Emitters in front of the closest object
+		float tHit = ray.index >= 0 ? ray.dist : 1.e30f;
+		AreaLight* lightHit = nullptr;
+		for (AreaLight* light : areaLights)
+		{
+			float t = light->intersect(ray.p0, ray.dir);
+			if (t > 0 && t < tHit) {
+				tHit = t;
+				lightHit = light;
+			}
+		}
+		if (lightHit != nullptr) {
+			glm::vec3 x = ray.p0 + ray.dir * tHit;
+			glm::vec3 Le = lightHit->emitted(ray.p0, x);
+			if (direct || (causticPath && scene.causticMap.size() > 0)) break;
+			if (specularBounce) L += beta * Le;
+			else L += beta * Le * powerHeuristic(bsdfPdf, lightPdf(lightHit, prevHit, prevNormal, x));
+			break;
+		}
+		if (ray.index == -1) break; // Background colour = (0,0,0)
+
+		SceneObject* obj = scene.objects[ray.index];
+		glm::vec3 hit = ray.hit;
+		if (!hitSurface) {
+			firstHit = hit;
+			hitSurface = true;
+		}
+		glm::vec3 col = scene.surfaceColor(ray.index, scene.textureCoords(ray.index, hit));
+		glm::vec3 normalVec = obj->normal(hit);
+		glm::vec3 wo = -ray.dir;
+
+		// Lobe weights, as in the Whitted shading
+		float transparency = obj->isTransparent() ? obj->getTransparencyCoeff() : 0;
+		float wDiffuse = 1 - transparency;
+		float wReflect = obj->isReflective() ? obj->getReflectionCoeff() * (1 - transparency) : 0;
+		float wRefract = obj->isRefractive() ? obj->getRefractionCoeff() : 0;
+		float total = wDiffuse + wReflect + transparency + wRefract;
+		if (total <= 0) break;
+		int dim = 1 + DIMS_PER_BOUNCE * bounce; // Dimension 0 is the position in the pixel
+		float u = ps.get2D(dim + 2).y * total;
+		bool last = bounce + 1 >= maxBounces;
+
+		glm::vec3 dir;
+		if (u < wDiffuse) {
+			glm::vec3 n = glm::dot(normalVec, wo) < 0 ? -normalVec : normalVec; // Side facing the viewer
+			glm::vec3 indirect;
+			if (useCache && cache.interpolate(hit, n, indirect)) {
+				// Indirect light from the cache ends the path, so direct light is not MIS weighted
+				L += beta * total * (sampleLights(obj, col, hit, n, wo, false, ps, dim) + scene.caustics(col, hit, n)
+					+ col * indirect);
+				break;
+			}
+			useCache = false; // Only the first diffuse vertex uses the cache
+			L += beta * total * (sampleLights(obj, col, hit, n, wo, true, ps, dim) + scene.caustics(col, hit, n));
+			if (last) break;
+			glm::vec2 uv = ps.get2D(dim + 1);
+			dir = cosineDirection(n, uv.x, uv.y);
+			float cosTheta = glm::dot(dir, n);
+			if (cosTheta <= 1.e-6) break;
+			bsdfPdf = cosTheta / PI;
+			beta *= total * brdf(obj, col, dir, wo, n) * PI;
+			specularBounce = false;
+			causticPath = false;
+			direct = false;
+			prevHit = hit;
+			prevNormal = n;
+		}
+		else {
+			if (last) break;
+			bool straight = false;
+			if (u < wDiffuse + wReflect) {
+				dir = glm::reflect(ray.dir, normalVec);
+			}
+			else if (u < wDiffuse + wReflect + transparency) {
+				dir = ray.dir; // Straight through, as seen by shadow rays: keeps the sampling state
+				straight = true;
+			}
+			else {
+				bool entering = glm::dot(ray.dir, normalVec) < 0;
+				glm::vec3 n = entering ? normalVec : -normalVec;
+				float eta = entering ? 1 / obj->getRefractiveIndex() : obj->getRefractiveIndex();
+				dir = glm::refract(ray.dir, n, eta);
+				if (glm::dot(dir, dir) < 1.e-6) dir = glm::reflect(ray.dir, n); // Total internal reflection
+			}
+			beta *= total;
+			if (!straight) {
+				if (!specularBounce) causticPath = true;
+				specularBounce = true;
+				direct = false;
+			}
+		}
+
+		if (bounce + 1 >= MIN_BOUNCES) {
+			float q = std::max(0.05f, 1 - std::max(beta.r, std::max(beta.g, beta.b)));
+			if (ps.uniform() < q) break;
+			beta /= 1 - q;
+		}
+		ray = Ray(hit, dir);
+	}
+
+	return L;
+}
+
+/**
+* Samples the indirect irradiance over the hemisphere around 'n' at 'p' on a
+* stratified grid of cosine-weighted directions, and estimates its rotation and
+* translation gradients (Ward and Heckbert) and the harmonic mean distance to
+* the surfaces seen.
+*/
+IrradianceRecord PathTracer::computeRecord(glm::vec3 p, glm::vec3 n, PathSample& ps)
+{
+	const int M = GATHER_THETA, N = GATHER_PHI;
+	glm::vec3 t1 = glm::normalize(glm::cross(n, fabs(n.x) > 0.5f ? glm::vec3(0, 1, 0) : glm::vec3(1, 0, 0)));
+	glm::vec3 t2 = glm::cross(n, t1);
+	glm::vec3 L[GATHER_THETA][GATHER_PHI];
+	float dist[GATHER_THETA][GATHER_PHI];
+
+	IrradianceRecord rec;
+	rec.position = p;
+	rec.normal = n;
+	rec.irradiance = glm::vec3(0);
+	rec.rotGradient = glm::mat3(0);
+	rec.transGradient = glm::mat3(0);
+	float inverseDistSum = 0;
+
+	for (int k = 0; k < N; k++)
+	{
+		glm::vec3 sumTan(0);
+		for (int j = 0; j < M; j++)
+		{
+			float u = (j + ps.uniform()) / M;
+			float phi = 2 * PI * (k + ps.uniform()) / N;
+			float sinTheta = sqrtf(u), cosTheta = sqrtf(1 - u);
+			glm::vec3 dir = (t1 * cosf(phi) + t2 * sinf(phi)) * sinTheta + n * cosTheta;
+			bool hitSurface;
+			glm::vec3 hit;
+			L[j][k] = tracePath(Ray(p, dir), ps, 1, true, hitSurface, hit);
+			dist[j][k] = hitSurface ? std::max(glm::length(hit - p), 1.e-3f) : 1.e6f;
+			rec.irradiance += L[j][k];
+			inverseDistSum += 1 / dist[j][k];
+			sumTan -= L[j][k] * (sinTheta / std::max(cosTheta, 1.e-3f));
+		}
+		float phi = 2 * PI * (k + 0.5f) / N;
+		glm::vec3 v = -t1 * sinf(phi) + t2 * cosf(phi);
+		for (int c = 0; c < 3; c++) rec.rotGradient[c] += v * sumTan[c];
+	}
+	rec.irradiance /= (float)(M * N);
+	rec.rotGradient /= (float)(M * N);
+
+	for (int k = 0; k < N; k++)
+	{
+		int kPrev = (k + N - 1) % N;
+		float phi = 2 * PI * (k + 0.5f) / N, phiMinus = 2 * PI * k / N;
+		glm::vec3 u = t1 * cosf(phi) + t2 * sinf(phi);
+		glm::vec3 vMinus = -t1 * sinf(phiMinus) + t2 * cosf(phiMinus);
+		glm::vec3 radial(0), angular(0);
+		for (int j = 0; j < M; j++)
+		{
+			float sinMinus = sqrtf((float)j / M), sinPlus = sqrtf((float)(j + 1) / M);
+			if (j > 0) {
+				float cos2Minus = 1 - (float)j / M;
+				radial += (L[j][k] - L[j - 1][k]) * (sinMinus * cos2Minus / std::min(dist[j][k], dist[j - 1][k]));
+			}
+			angular += (L[j][k] - L[j][kPrev]) * ((sinPlus - sinMinus) / std::min(dist[j][k], dist[j][kPrev]));
+		}
+		for (int c = 0; c < 3; c++) rec.transGradient[c] += u * (2 * PI / N * radial[c]) + vMinus * angular[c];
+	}
+	rec.transGradient /= PI; // Gradient of irradiance / pi
+
+	// Harmonic mean distance, reduced where the gradient predicts a large change
+	rec.radius = M * N / inverseDistSum;
+	float maxIrradiance = std::max(rec.irradiance.r, std::max(rec.irradiance.g, rec.irradiance.b));
+	float maxGradient = 0;
+	for (int c = 0; c < 3; c++) maxGradient = std::max(maxGradient, glm::length(rec.transGradient[c]));
+	if (maxGradient > 0) rec.radius = std::min(rec.radius, maxIrradiance / maxGradient);
+	rec.radius = glm::clamp(rec.radius, cache.getMinRadius(), cache.getMaxRadius());
+	return rec;
+}
+
+/**
+* Fills the irradiance cache at the primary diffuse hits of a coarse pixel grid,
+* refined in passes over finer grids. The records of a pass are computed in
+* parallel for the points not yet covered by the cache, then inserted together.
+*/
+void PathTracer::populateCache()
+{
+	int n = camera.getNumDiv();
+	cache.clear();
+	for (int spacing = CACHE_SPACING; spacing >= CACHE_MIN_SPACING; spacing /= 2)
+	{
+		std::vector<glm::vec3> points, normals;
+		std::vector<int> pixels;
+		for (int j = spacing / 2; j < n; j += spacing)
+		{
+			for (int i = spacing / 2; i < n; i += spacing)
+			{
+				Ray ray = camera.primaryRay(i, j);
+				ray.closestPt(scene.objects);
+				if (ray.index == -1) continue;
+				SceneObject* obj = scene.objects[ray.index];
+				if (obj->isTransparent() && obj->getTransparencyCoeff() >= 1) continue; // No diffuse lobe
+				glm::vec3 normalVec = obj->normal(ray.hit);
+				if (glm::dot(normalVec, ray.dir) > 0) normalVec = -normalVec;
+				glm::vec3 irradiance;
+				if (cache.interpolate(ray.hit, normalVec, irradiance)) continue;
+				points.push_back(ray.hit);
+				normals.push_back(normalVec);
+				pixels.push_back(j * n + i);
+			}
+		}
+
+		std::vector<IrradianceRecord> records(points.size());
+		parallelFor(points.size(), [&](int r) {
+			PathSample ps; // Gather paths are already stratified: no sampler
+			ps.rng.seed(pixelSeed(pixels[r], -spacing));
+			records[r] = computeRecord(points[r], normals[r], ps);
+		});
+		for (IrradianceRecord& rec : records) cache.insert(rec);
+	}
+}
+
+
+
+/**
+* Collects the lights that paths can hit and, when enabled, fills the irradiance cache.
+*/
+void PathTracer::beginFrame()
+{
+	areaLights.clear();
+	for (Light* light : scene.lights)
+	{
+		AreaLight* area = dynamic_cast<AreaLight*>(light);
+		if (area != nullptr) areaLights.push_back(area);
+	}
+	if (irradianceCaching && cache.size() == 0) populateCache(); // The scene is static: built once
+}
+
+/**
+* Records the AOVs of a pixel from the camera ray through its centre (rather than
+* a jittered one, which would make the features as noisy as the colour).
+*/
+void PathTracer::writeAOVs(FrameBuffer* aovs, int pixel, Ray ray)
+{
+	ray.closestPt(scene.objects);
+	scene.countRay();
+	aovs->writeHit(pixel, scene, ray);
+}
+
+/**
+* Traces path 'index' of at most 'count' paths through cell (i, j). Every path has
+* its own random sequence, so paths can be added to a pixel in any order. The
+* first path also records the AOVs of the cell in 'aovs', if given.
+*/
+glm::vec3 PathTracer::sample(int i, int j, int index, int count, FrameBuffer* aovs)
+{
+	int n = camera.getNumDiv();
+	PathSample ps;
+	ps.rng.seed(pixelSeed((int)((unsigned int)index * n * n + j * n + i), frameIndex));
+	ps.sampler = scene.sampler;
+	ps.pixel = glm::ivec2(i, j + n * frameIndex);
+	ps.index = index;
+	ps.count = count;
+	glm::vec2 d = ps.get2D(0);
+	if (aovs != nullptr && index == 0) writeAOVs(aovs, j * n + i, camera.primaryRay(i, j));
+	return radiance(camera.primaryRay(i, j, d.x, d.y), ps);
+}
+
+/**
+* Renders the scene into 'frame' (row major, starting from the bottom left pixel),
+* with 'samplesPerPixel' jittered paths per pixel. Rows are shared between threads.
+* With 'adaptive', the paths are spent where the image is noisiest instead. The
+* AOVs enabled in 'aovs', if given, are recorded with the first path of every pixel.
+*/
+void PathTracer::render(std::vector<glm::vec3>& frame, AdaptiveRenderer* adaptive, FrameBuffer* aovs)
+{
+	int n = camera.getNumDiv();
+	beginFrame();
+
+	if (adaptive != nullptr) {
+		adaptive->render(frame, [&](int i, int j, int index, int count) { return sample(i, j, index, count, aovs); });
+		frameIndex++;
+		return;
+	}
+
+	frame.assign(n * n, glm::vec3(0));
+	parallelFor(n, [&](int j) {
+		for (int i = 0; i < n; i++)
+		{
+			PathSample ps;
+			ps.rng.seed(pixelSeed(j * n + i, frameIndex));
+			ps.sampler = scene.sampler;
+			ps.pixel = glm::ivec2(i, j + n * frameIndex); // New sample sets in every frame
+			ps.count = samplesPerPixel;
+			glm::vec3 sum(0);
+			for (int s = 0; s < samplesPerPixel; s++)
+			{
+				ps.index = s;
+				glm::vec2 d = ps.get2D(0);
+				if (aovs != nullptr && s == 0) writeAOVs(aovs, j * n + i, camera.primaryRay(i, j));
+				sum += radiance(camera.primaryRay(i, j, d.x, d.y), ps);
+			}
+			frame[j * n + i] = sum / (float)samplesPerPixel;
+		}
+	});
+	frameIndex++;
+}
+
+void PathTracer::setSamples(int spp)
+{
+	samplesPerPixel = std::max(1, spp);
+}
+
+void PathTracer::setMaxBounces(int bounces)
+{
+	maxBounces = std::max(1, bounces);
+}
+
+int PathTracer::getSamples()
+{
+	return samplesPerPixel;
+}
+
+void PathTracer::setIrradianceCaching(bool enabled, float accuracy)
+{
+	irradianceCaching = enabled;
+	cache.setAccuracy(accuracy);
+}
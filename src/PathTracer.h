@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#ifndef H_PATHTRACER
+#define H_PATHTRACER
+#include <glm/glm.hpp>
+#include <vector>
+#include <random>
+#include "Scene.h"
+#include "Camera.h"
+#include "AreaLight.h"
+#include "IrradianceCache.h"
+#include "Sampler.h"
+#include "AdaptiveRenderer.h"
+#include "FrameBuffer.h"
+
+/**
+ * Source of the random numbers of one path. Dimensions covered by a sampler come
+ * from sample 'index' of the 'count' samples of 'pixel'; the rest (and all of
+ * them without a sampler) come from the random sequence 'rng'.
+ */
+struct PathSample
+{
+	std::minstd_rand rng;
+	Sampler* sampler = nullptr;
+	glm::ivec2 pixel = glm::ivec2(0);
+	int index = 0;
+	int count = 1;
+
+	float uniform();
+
+	glm::vec2 get2D(int dim);
+};
+
+/**
+ * Monte Carlo path tracer for global illumination. Surfaces reflect diffusely
+ * (with the Whitted highlight as a glossy term) and, depending on their material
+ * flags, also as perfect mirrors or by refraction; one of these lobes is chosen
+ * at random at every bounce. Diffuse bounces are sampled with a cosine-weighted
+ * distribution, and direct light is added by next-event estimation at every
+ * diffuse vertex. Light from area lights found by both strategies is combined
+ * with multiple importance sampling (power heuristic). When the scene has a
+ * caustic map, light reaching a diffuse surface through specular objects is
+ * taken from it instead of from the paths. With irradiance caching, the indirect
+ * light at the first diffuse vertex of a path is interpolated from sparse records.
+ */
+class PathTracer
+{
+
+private:
+	Scene& scene;
+	Camera& camera;
+	int samplesPerPixel = 16;
+	int maxBounces = 5;
+	int frameIndex = 0; // Decorrelates the random numbers of successive frames
+	std::vector<AreaLight*> areaLights; // Lights that paths can hit
+	bool irradianceCaching = false;
+	IrradianceCache cache;
+
+	static const int GATHER_THETA = 10; // Hemisphere strata of an irradiance record: theta x phi
+	static const int GATHER_PHI = 30;
+
+	glm::vec3 brdf(SceneObject* obj, glm::vec3 col, glm::vec3 wi, glm::vec3 wo, glm::vec3 n);
+	float lightPdf(AreaLight* light, glm::vec3 p, glm::vec3 n, glm::vec3 x);
+	glm::vec3 sampleLight(Light* light, float selectPdf, SceneObject* obj, glm::vec3 col, glm::vec3 hit,
+		glm::vec3 n, glm::vec3 wo, bool mis, glm::vec2 uv);
+	glm::vec3 sampleLights(SceneObject* obj, glm::vec3 col, glm::vec3 hit, glm::vec3 n, glm::vec3 wo,
+		bool mis, PathSample& ps, int dim);
+	glm::vec3 tracePath(Ray ray, PathSample& ps, int firstBounce, bool gather,
+		bool& hitSurface, glm::vec3& firstHit);
+	IrradianceRecord computeRecord(glm::vec3 p, glm::vec3 n, PathSample& ps);
+	void populateCache();
+	void beginFrame();
+	void writeAOVs(FrameBuffer* aovs, int pixel, Ray ray);
+
+public:
+	PathTracer(Scene& s, Camera& c) : scene(s), camera(c) {}
+
+	glm::vec3 radiance(Ray ray, PathSample& ps);
+
+	glm::vec3 sample(int i, int j, int index, int count, FrameBuffer* aovs = nullptr);
+
+	void render(std::vector<glm::vec3>& frame, AdaptiveRenderer* adaptive = nullptr, FrameBuffer* aovs = nullptr);
+
+	void setSamples(int spp);
+
+	void setMaxBounces(int bounces);
+
+	int getSamples();
+
+	void setIrradianceCaching(bool enabled, float accuracy);
+
+};
+
+#endif //!H_PATHTRACER
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "PhotonMap.h"
+#include "Parallel.h"
+#include <math.h>
+#include <algorithm>
+
+const float PI = 3.14159265f;
+const int MAX_NEIGHBOURS = 256;
+const int HASH_SLOTS = 1 << 16; // Hash table size, a power of two independent of the photon count
+
+unsigned int PhotonMap::cellHash(int x, int y, int z)
+{
+	unsigned int h = (x * 73856093u) ^ (y * 19349663u) ^ (z * 83492791u);
+	return h & (HASH_SLOTS - 1);
+}
+
+glm::ivec3 PhotonMap::cellOf(glm::vec3 p)
+{
+	return glm::ivec3(floorf(p.x / radius), floorf(p.y / radius), floorf(p.z / radius));
+}
+
+/**
+* Sorts the photons of 'stored' into the grid (a counting sort on the cell hash).
+* Hashing and scattering are split into one chunk per thread, each with its own
+* histogram over the hash table; each chunk writes to its own range of every slot,
+* so the order within a slot is stable.
+*/
+void PhotonMap::build(std::vector<Photon>& stored, float gatherRadius)
+{
+	radius = gatherRadius;
+	int count = stored.size();
+	int slots = HASH_SLOTS;
+	cellStart.assign(slots + 1, 0);
+	photons.resize(count);
+	if (count == 0) return;
+
+	int chunks = std::min(getThreadCount(), std::max(1, count / 65536)); // Enough photons to fill a histogram
+	int chunkSize = (count + chunks - 1) / chunks;
+	std::vector<unsigned int> slot(count);
+	std::vector<std::vector<int>> histogram(chunks, std::vector<int>(slots, 0));
+
+	parallelFor(chunks, [&](int c) {
+		int end = std::min(count, (c + 1) * chunkSize);
+		for (int i = c * chunkSize; i < end; i++)
+		{
+			glm::ivec3 cell = cellOf(stored[i].position);
+			slot[i] = cellHash(cell.x, cell.y, cell.z);
+			histogram[c][slot[i]]++;
+		}
+	});
+
+	// Exclusive prefix sum over (slot, chunk), turning the counts into write offsets
+	int offset = 0;
+	for (int s = 0; s < slots; s++)
+	{
+		cellStart[s] = offset;
+		for (int c = 0; c < chunks; c++)
+		{
+			int n = histogram[c][s];
+			histogram[c][s] = offset;
+			offset += n;
+		}
+	}
+	cellStart[slots] = offset;
+
+	parallelFor(chunks, [&](int c) {
+		int end = std::min(count, (c + 1) * chunkSize);
+		for (int i = c * chunkSize; i < end; i++)
+		{
+			photons[histogram[c][slot[i]]++] = stored[i];
+		}
+	});
+}
+
+/**
+* Irradiance at 'p' on a surface with normal 'n', estimated from the density of
+* the 'neighbours' nearest photons within the gather radius that arrived at the
+* front of the surface.
+*/
+glm::vec3 PhotonMap::irradiance(glm::vec3 p, glm::vec3 n)
+{
+	if (photons.empty()) return glm::vec3(0);
+
+	// Max-heap on squared distance of the nearest photons found so far
+	std::pair<float, int> heap[MAX_NEIGHBOURS];
+	int found = 0;
+	float maxDist2 = radius * radius;
+	glm::ivec3 cell = cellOf(p);
+	unsigned int visited[27];
+	int numVisited = 0;
+
+	for (int dz = -1; dz <= 1; dz++)
+	for (int dy = -1; dy <= 1; dy++)
+	for (int dx = -1; dx <= 1; dx++)
+	{
+		unsigned int s = cellHash(cell.x + dx, cell.y + dy, cell.z + dz);
+		if (std::find(visited, visited + numVisited, s) != visited + numVisited) continue; // Hash collision
+		visited[numVisited++] = s;
+		for (int i = cellStart[s]; i < cellStart[s + 1]; i++)
+		{
+			const Photon& photon = photons[i];
+			glm::vec3 d = photon.position - p;
+			float dist2 = glm::dot(d, d);
+			if (dist2 >= maxDist2 || glm::dot(photon.dir, n) >= 0) continue;
+			if (found < neighbours) {
+				heap[found++] = std::make_pair(dist2, i);
+				std::push_heap(heap, heap + found);
+				if (found == neighbours) maxDist2 = heap[0].first;
+			}
+			else {
+				std::pop_heap(heap, heap + found);
+				heap[found - 1] = std::make_pair(dist2, i);
+				std::push_heap(heap, heap + found);
+				maxDist2 = heap[0].first;
+			}
+		}
+	}
+
+	if (found == 0) return glm::vec3(0);
+	glm::vec3 power(0);
+	for (int k = 0; k < found; k++) power += photons[heap[k].second].power;
+	return power / (PI * maxDist2);
+}
+
+void PhotonMap::setNeighbours(int k)
+{
+	neighbours = std::max(1, std::min(k, MAX_NEIGHBOURS));
+}
+
+int PhotonMap::size()
+{
+	return photons.size();
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#ifndef H_PHOTONMAP
+#define H_PHOTONMAP
+#include <glm/glm.hpp>
+#include <vector>
+
+/**
+ * A photon stored where it landed on a diffuse surface.
+ */
+struct Photon
+{
+	glm::vec3 position;
+	glm::vec3 power;
+	glm::vec3 dir; // Direction of travel when the photon arrived
+};
+
+/**
+ * Photons stored in a hashed uniform grid whose cells are as wide as the gather
+ * radius. The photons are kept sorted by cell, so a lookup only reads the
+ * contiguous runs of the 27 cells around the query point.
+ */
+class PhotonMap
+{
+
+private:
+	std::vector<Photon> photons; // Sorted by cell
+	std::vector<int> cellStart; // First photon of each hash table slot, plus an end marker
+	float radius = 1; // Gather radius, also the cell width
+	int neighbours = 50; // Photons used for each density estimate
+
+	unsigned int cellHash(int x, int y, int z);
+	glm::ivec3 cellOf(glm::vec3 p);
+
+public:
+	PhotonMap() {}
+
+	void build(std::vector<Photon>& stored, float gatherRadius);
+
+	glm::vec3 irradiance(glm::vec3 p, glm::vec3 n);
+
+	void setNeighbours(int k);
+
+	int size();
+
+};
+
+#endif //!H_PHOTONMAP
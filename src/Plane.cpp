@@ -68,5 +68,15 @@ int  Plane::getNumVerts()
 	return nverts_;
 }
 
-
-
+/**
+* Texture coordinates of a point on the plane: its position along the edges from
+* the first vertex to the second and to the last (0 at the first vertex, 1 at the
+* other end of the edge).
+*/
+glm::vec2 Plane::textureCoords(glm::vec3 pt)
+{
+	glm::vec3 u = b_ - a_;
+	glm::vec3 v = (nverts_ == 4 ? d_ : c_) - a_;
+	glm::vec3 q = pt - a_;
+	return glm::vec2(glm::dot(q, u) / glm::dot(u, u), glm::dot(q, v) / glm::dot(v, v));
+}
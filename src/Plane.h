@@ -38,6 +38,8 @@ public:
 	
 	glm::vec3 normal(glm::vec3 pt);
 
+	glm::vec2 textureCoords(glm::vec3 pt);
+
 };
 
 #endif //!H_PLANE
@@ -0,0 +1,31 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "PointLight.h"
+#include <glm/gtc/constants.hpp>
+
+glm::vec3 PointLight::illuminate(glm::vec3 p, glm::vec3& lightVec, float& lightDist)
+{
+	lightVec = position - p;
+	lightDist = glm::length(lightVec);
+	lightVec = lightVec / lightDist;
+	return intensity_ * attenuation(lightDist) * color_;
+}
+
+bool PointLight::emissionBounds(glm::vec3& pos, glm::vec3& axis, float& thetaO, float& thetaE)
+{
+	pos = position;
+	axis = glm::vec3(0, 1, 0);
+	thetaO = glm::pi<float>(); // Emits in all directions
+	thetaE = glm::half_pi<float>();
+	return true;
+}
+
+glm::vec3 PointLight::getPosition()
+{
+	return position;
+}
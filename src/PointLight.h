@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#ifndef H_POINTLIGHT
+#define H_POINTLIGHT
+#include <glm/glm.hpp>
+#include "Light.h"
+
+/**
+ * Defines a light that shines equally in all directions from 'position'.
+ */
+class PointLight : public Light
+{
+
+protected:
+	glm::vec3 position = glm::vec3(0);
+
+public:
+	PointLight() {};
+
+	PointLight(glm::vec3 pos) : position(pos) {}
+
+	glm::vec3 illuminate(glm::vec3 p, glm::vec3& lightVec, float& lightDist);
+
+	bool emissionBounds(glm::vec3& pos, glm::vec3& axis, float& thetaO, float& thetaE);
+
+	glm::vec3 getPosition();
+
+};
+
+#endif //!H_POINTLIGHT
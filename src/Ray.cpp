@@ -6,6 +6,9 @@
  */
 
 #include "Ray.h"
+#include <math.h>
+
+thread_local std::vector<bool>* Ray::touched = nullptr;
 
 // Finds the closest point of intersection of the current ray with scene objects.
 void Ray::closestPt(std::vector<SceneObject*> &sceneObjects)
@@ -27,5 +30,101 @@ void Ray::closestPt(std::vector<SceneObject*> &sceneObjects)
 			}
 		}
 	}
+	if (touched != nullptr && index >= 0) (*touched)[index] = true;
+}
+
+// Returns the fraction of light transmitted along the ray over the distance 'maxDist'.
+// Transparent and refractive objects let through their transparency coefficient; the
+// query stops at the first opaque object, in any order, without finding the closest one.
+float Ray::transmittance(std::vector<SceneObject*> &sceneObjects, float maxDist)
+{
+	float trans = 1;
+	for (size_t i = 0; i < sceneObjects.size(); i++)
+	{
+		float t = sceneObjects[i]->intersect(p0, dir);
+		if (t > 0 && t < maxDist) // Intersects the object before the end of the ray.
+		{
+			SceneObject* obj = sceneObjects[i];
+			if (touched != nullptr) (*touched)[i] = true;
+			if (!obj->isTransparent() && !obj->isRefractive()) return 0; // Opaque blocker
+			trans *= obj->getTransparencyCoeff();
+			if (trans <= 0) return 0;
+		}
+	}
+	return trans;
+}
+
+// Returns true if any object intersects the ray within the distance 'maxDist'.
+// Stops at the first such object (any-hit query).
+bool Ray::occluded(std::vector<SceneObject*>& sceneObjects, float maxDist)
+{
+	for (size_t i = 0; i < sceneObjects.size(); i++)
+	{
+		float t = sceneObjects[i]->intersect(p0, dir);
+		if (t > 0 && t < maxDist) {
+			if (touched != nullptr) (*touched)[i] = true;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Offsets from the hit of the ray to the hits of the neighbouring rays described by
+// its differentials, on the tangent plane with normal 'normalVec' (Igehy's transfer).
+void Ray::hitDifferentials(glm::vec3 normalVec, glm::vec3& dHdx, glm::vec3& dHdy) const
+{
+	float dDotn = glm::dot(dir, normalVec);
+	if (!hasDifferentials || fabs(dDotn) < 1.e-6) {
+		dHdx = dHdy = glm::vec3(0);
+		return;
+	}
+	glm::vec3 ex = dPdx + dist * dDdx;
+	glm::vec3 ey = dPdy + dist * dDdy;
+	dHdx = ex - dir * (glm::dot(ex, normalVec) / dDotn);
+	dHdy = ey - dir * (glm::dot(ey, normalVec) / dDotn);
 }
 
+// Gives the ray the differentials of the reflection of 'incident' at its hit on 'obj',
+// where 'normalVec' is the normal it was reflected about. The change of the normal
+// across the footprint is found by evaluating it at the neighbouring hits.
+void Ray::reflectDifferentials(const Ray& incident, SceneObject* obj, glm::vec3 normalVec)
+{
+	hasDifferentials = incident.hasDifferentials;
+	if (!hasDifferentials) return;
+	incident.hitDifferentials(normalVec, dPdx, dPdy);
+	glm::vec3 n = obj->normal(incident.hit);
+	float side = glm::dot(n, normalVec) < 0 ? -1.0f : 1.0f;
+	glm::vec3 dndx = side * (obj->normal(incident.hit + dPdx) - n);
+	glm::vec3 dndy = side * (obj->normal(incident.hit + dPdy) - n);
+	glm::vec3 d = incident.dir;
+	float dDotn = glm::dot(d, normalVec);
+	dDdx = incident.dDdx - 2.0f * (dDotn * dndx + (glm::dot(incident.dDdx, normalVec) + glm::dot(d, dndx)) * normalVec);
+	dDdy = incident.dDdy - 2.0f * (dDotn * dndy + (glm::dot(incident.dDdy, normalVec) + glm::dot(d, dndy)) * normalVec);
+}
+
+// Gives the ray the differentials of the refraction of 'incident' at its hit on 'obj'
+// with the ratio of refractive indices 'eta', as computed by glm::refract() with the
+// normal 'normalVec'. Total internal reflection leaves the ray without differentials.
+void Ray::refractDifferentials(const Ray& incident, SceneObject* obj, glm::vec3 normalVec, float eta)
+{
+	hasDifferentials = incident.hasDifferentials;
+	if (!hasDifferentials) return;
+	glm::vec3 d = incident.dir;
+	float dDotn = glm::dot(d, normalVec);
+	float k = 1 - eta * eta * (1 - dDotn * dDotn);
+	if (k <= 0) {
+		hasDifferentials = false;
+		return;
+	}
+	incident.hitDifferentials(normalVec, dPdx, dPdy);
+	glm::vec3 n = obj->normal(incident.hit);
+	float side = glm::dot(n, normalVec) < 0 ? -1.0f : 1.0f;
+	glm::vec3 dndx = side * (obj->normal(incident.hit + dPdx) - n);
+	glm::vec3 dndy = side * (obj->normal(incident.hit + dPdy) - n);
+	float mu = eta * dDotn + sqrtf(k);
+	float dmuScale = eta + eta * eta * dDotn / sqrtf(k); // d(mu) / d(d . n)
+	float dDotnx = glm::dot(incident.dDdx, normalVec) + glm::dot(d, dndx);
+	float dDotny = glm::dot(incident.dDdy, normalVec) + glm::dot(d, dndy);
+	dDdx = eta * incident.dDdx - (mu * dndx + dmuScale * dDotnx * normalVec);
+	dDdy = eta * incident.dDdy - (mu * dndy + dmuScale * dDotny * normalVec);
+}
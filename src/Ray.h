@@ -20,6 +20,10 @@ public:
 	glm::vec3 hit = glm::vec3(0); // The closest point of intersection on the ray.
 	int index = -1; // The index of the object that gives the closet point of intersection.
 	float dist = 0; // The distance from the p0 to hit along the ray.
+	bool hasDifferentials = false; // Whether the ray differentials below are tracked.
+	glm::vec3 dPdx = glm::vec3(0), dPdy = glm::vec3(0); // Offsets of the source points of the rays one pixel across and up.
+	glm::vec3 dDdx = glm::vec3(0), dDdy = glm::vec3(0); // Offsets of their directions.
+	static thread_local std::vector<bool>* touched; // When set, flags the objects that decide the queries of this thread.
 
 	Ray() {} // Default constructor
 
@@ -34,6 +38,16 @@ public:
 
 	void closestPt(std::vector<SceneObject*>& sceneObjects);
 
+	float transmittance(std::vector<SceneObject*>& sceneObjects, float maxDist);
+
+	bool occluded(std::vector<SceneObject*>& sceneObjects, float maxDist);
+
+	void hitDifferentials(glm::vec3 normalVec, glm::vec3& dHdx, glm::vec3& dHdy) const;
+
+	void reflectDifferentials(const Ray& incident, SceneObject* obj, glm::vec3 normalVec);
+
+	void refractDifferentials(const Ray& incident, SceneObject* obj, glm::vec3 normalVec, float eta);
+
 };
 
 #endif
@@ -8,6 +8,15 @@
 #include <iostream>
 #include <cmath>
 #include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <random>
+#include <thread>
+#include <functional>
+#include <string>
 #include <glm/glm.hpp>
 #include "Sphere.h"
 #include "SceneObject.h"
@@ -17,113 +26,83 @@
 #include "Cone.h"
 #include "Cylinder.h"
 #include "TextureBMP.h"
+#include "TextureCache.h"
+#include "TextureManager.h"
+#include "PointLight.h"
+#include "DirectionalLight.h"
+#include "SpotLight.h"
+#include "RectLight.h"
+#include "DiskLight.h"
+#include "SphereLight.h"
+#include "Scene.h"
+#include "Camera.h"
+#include "DeferredRenderer.h"
+#include "WavefrontRenderer.h"
+#include "PathTracer.h"
+#include "AdaptiveRenderer.h"
+#include "Denoiser.h"
+#include "FrameBuffer.h"
+#include "TemporalAccumulator.h"
+#include "CheckerboardRenderer.h"
+#include "LightBufferRenderer.h"
+#include "IncrementalRenderer.h"
+#include "Parallel.h"
+#include "JitteredSampler.h"
+#include "SobolSampler.h"
+#include "BlueNoiseSampler.h"
+#include "LatticeSampler.h"
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
 using namespace std;
 
 const float WIDTH = 20.0;
 const float HEIGHT = 20.0;
 const float EDIST = 40.0;
 const int NUMDIV = 500;
-const int MAX_STEPS = 5;
 const float XMIN = -WIDTH * 0.5;
 const float XMAX = WIDTH * 0.5;
 const float YMIN = -HEIGHT * 0.5;
 const float YMAX = HEIGHT * 0.5;
 
-vector<SceneObject*> sceneObjects;
-TextureBMP texture;
-
-
-// Computes the colour value obtained by tracing a ray and finding its 
-// closest point of intersection with objects in the scene.
-glm::vec3 trace(Ray ray, int step)
-{
-	glm::vec3 backgroundCol(0);	// Background colour = (0,0,0)
-	glm::vec3 lightPos(10, 40, -3); // Light's position
-	glm::vec3 color(0);
-	SceneObject* obj;
-
-	ray.closestPt(sceneObjects); // Compare the ray with all objects in the scene
-	if (ray.index == -1) return backgroundCol; // No intersection
-	obj = sceneObjects[ray.index]; // Object on which the closest point of intersection is found
-
-	if (ray.index == 0) {
-		// Chequered pattern
-		int stripeWidth = 5;
-		int iz = (ray.hit.z + 100) / stripeWidth;
-		int ix = (ray.hit.x + 100) / stripeWidth;
-		int k = iz % 2; // 2 colors
-		int j = ix % 2;
-		if ((k && j) || (!k && !j)) {
-			color = glm::vec3(0, 1, 0);
-		}
-		else {
-			color = glm::vec3(1, 1, 0.5);
-		}
-		obj->setColor(color);
-	}
-
-	if (ray.index == 3) {
-		// Textured sphere
-		glm::vec3 norm = glm::normalize(ray.hit - glm::vec3(5.0, 5.0, -70.0));
-		float texcoords = (0.5 - atan2(norm.z, norm.x) + 3.14) / (2 * 3.14);
-		float texcoordt = 0.5 + asin(norm.y) / 3.14;
-		color = texture.getColorAt(texcoords, texcoordt);
-		obj->setColor(color);
-	}
-
-	color = obj->lighting(lightPos, -ray.dir, ray.hit); // Object's lighting
-	glm::vec3 lightVec = lightPos - ray.hit; // Vector from the point of intersection to the light source
-	Ray shadowRay(ray.hit, lightVec); // Shadow ray at the point of intersection
-	shadowRay.closestPt(sceneObjects); // Closest point of intersection on the shadow ray
-	float lightDist = glm::length(lightVec); // distance to the light source
-
-	// Fog
-	int z1 = -70;
-	int z2 = -150;
-	float t = (ray.hit.z - z1) / (z2 - z1);
-	color = (1 - t) * color + glm::vec3(t, t, t);
-
-	if (shadowRay.index > -1 && shadowRay.dist < lightDist) { // If shadow ray hits and object and the disance to the point of intersection on this object is smaller than the distance to the light source
-		if (shadowRay.index == 3 || shadowRay.index == 1) {
-			color = 0.6f * obj->getColor(); // 0.4 = ambient scale factor
-		}
-		else {
-			color = 0.2f * obj->getColor(); // 0.2 = ambient scale factor
-		}
-	}
-
-	if (obj->isReflective() && step < MAX_STEPS) {
-		float rho = obj->getReflectionCoeff();
-		glm::vec3 normalVec = obj->normal(ray.hit);
-		glm::vec3 reflectedDir = glm::reflect(ray.dir, normalVec);
-		Ray reflectedRay(ray.hit, reflectedDir);
-		glm::vec3 reflectedColor = trace(reflectedRay, step + 1);
-		color = color + (rho * reflectedColor);
-	}
-
-	if (obj->isTransparent() && step < MAX_STEPS) {
-		float tho = obj->getTransparencyCoeff();
-		color = color * (1 - tho);
-	}
-
-	if (obj->isRefractive() && step < MAX_STEPS)
-	{
-		float rho = obj->getRefractionCoeff();
-		float refractiveIndex = obj->getRefractiveIndex();
-		float eta = 1 / refractiveIndex;
-		glm::vec3 n = obj->normal(ray.hit);
-		glm::vec3 g = glm::refract(ray.dir, n, eta);
-		Ray refrRay(ray.hit, g);
-		refrRay.closestPt(sceneObjects);
-		glm::vec3 m = obj->normal(refrRay.hit);
-		glm::vec3 h = glm::refract(g, -m, 1.0f / eta);
-		Ray r(refrRay.hit, h);
-		glm::vec3 refractedColor = trace(r, step + 1);
-		color = color + (rho * refractedColor);
-	}
-
-	return color;
-}
+enum RenderMode { WHITTED, DEFERRED, WAVEFRONT, PATH, AO };
+
+TextureCache textureCache; // Before the scene: its streamed textures unregister on destruction
+TextureManager textureManager(&textureCache);
+Scene scene;
+Camera camera(glm::vec3(0., 0., 0.), WIDTH, HEIGHT, EDIST, NUMDIV);
+DeferredRenderer deferred(scene, camera);
+WavefrontRenderer wavefront(scene, camera);
+PathTracer pathTracer(scene, camera);
+AdaptiveRenderer adaptive(camera);
+Denoiser denoiser(scene, camera);
+TemporalAccumulator temporal(camera);
+CheckerboardRenderer checkerboard(scene, camera);
+LightBufferRenderer lightBuffers(scene, camera);
+IncrementalRenderer incremental(scene, camera);
+RenderMode mode = WHITTED;
+bool softShadows = false; // Light the built-in scene with an area light instead of a point light
+int extraLights = 0; // Number of additional small lights scattered over the built-in scene
+int aaSamples = 1; // Primary rays per cell of the Whitted renderer
+bool adaptiveSampling = false; // Spend the samples where the image is noisiest
+bool denoising = false; // Filter the noise out of finished frames
+bool temporalAccumulation = false; // Reuse the samples of previous frames
+glm::vec3 cameraVelocity(0); // Camera movement per frame (fly-through)
+bool checkerboardRendering = false; // Secondary rays for half of the pixels of the Whitted renderer
+bool relighting = false; // Keep per-light buffers in the Whitted renderer
+bool lightsChanged = false; // Light scales edited since the last frame: recompose only
+int selectedLight = 0; // Light whose scale the keyboard edits
+bool incrementalRendering = false; // Re-render only the tiles changed by scene edits
+TextureBMP::Layout textureLayout = TextureBMP::ROW_MAJOR; // Texel layout of the scene texture; STREAMED loads tiles on demand into the texture cache
+int selectedObject = 0; // Object whose colour the keyboard edits
+int photonCount = 0; // Photons emitted for the caustic map, 0 = no caustics
+float photonRadius = 1.0; // Gather radius of the caustic map
+unsigned int aovChannels = 0; // AOVs written alongside the colour
+string aovPrefix; // Files the frame is written to, empty for none
 
 
 // Creates a single cube scene object and adds it to the list of scene objects.
@@ -140,49 +119,194 @@ void drawCube(float x, float y, float z, float lwh, glm::vec3 colour)
 
 	Plane* plane1 = new Plane(A, B, C, D);
 	plane1->setColor(colour);
-	sceneObjects.push_back(plane1);
+	scene.objects.push_back(plane1);
 
 	Plane* plane2 = new Plane(B, E, F, C);
 	plane2->setColor(colour);
-	sceneObjects.push_back(plane2);
+	scene.objects.push_back(plane2);
 
 	Plane* plane3 = new Plane(E, H, G, F);
 	plane3->setColor(colour);
-	sceneObjects.push_back(plane3);
+	scene.objects.push_back(plane3);
 
 	Plane* plane4 = new Plane(D, G, H, A);
 	plane4->setColor(colour);
-	sceneObjects.push_back(plane4);
+	scene.objects.push_back(plane4);
 
 	Plane* plane5 = new Plane(D, C, F, G);
 	plane5->setColor(colour);
-	sceneObjects.push_back(plane5);
+	scene.objects.push_back(plane5);
 
 	Plane* plane6 = new Plane(H, E, B, A);
 	plane6->setColor(colour);
-	sceneObjects.push_back(plane6);
+	scene.objects.push_back(plane6);
 }
 
 
-// Uses the concept of Supersampling to add anti-aliasing to the scene.
-glm::vec3 antiAliasing(glm::vec3 eye, float cellX, float cellY, float xp, float yp)
+// Uses the concept of Supersampling to add anti-aliasing to the scene: traces
+// 'samples' rays through cell (i, j), placed by the scene's sampler or, without
+// one, at the centres of a regular grid of sub-cells (2x2 for 4 samples).
+glm::vec3 antiAliasing(int i, int j, int samples)
 {
 	glm::vec3 colour(0);
+	int nx = (int)ceil(sqrt((float)samples));
+	int ny = (samples + nx - 1) / nx;
 
-	Ray ray = Ray(eye, glm::vec3(xp + cellX * 0.25, yp + cellY * 0.25, -EDIST));
-	colour += trace(ray, 1);
+	for (int s = 0; s < samples; s++)
+	{
+		glm::vec2 d = scene.sampler != nullptr ? scene.sampler->get2D(glm::ivec2(i, j), s, samples, 0)
+			: glm::vec2((s % nx + 0.5f) / nx, (s / nx + 0.5f) / ny);
+		colour += scene.trace(camera.primaryRay(i, j, d.x, d.y), 1);
+	}
+
+	colour *= glm::vec3(1.0f / samples);
+	return colour;
+}
 
-	ray = Ray(eye, glm::vec3(xp + cellX * 0.25, yp + cellY * 0.75, -EDIST));
-	colour += trace(ray, 1);
 
-	ray = Ray(eye, glm::vec3(xp + cellX * 0.75, yp + cellY * 0.25, -EDIST));
-	colour += trace(ray, 1);
+// Intersects the primary ray through point (dx, dy) of cell (i, j) with the scene
+// and, with 'aovs', records the AOVs of the cell from its hit.
+Ray primaryHit(int i, int j, float dx, float dy, FrameBuffer* aovs)
+{
+	Ray ray = camera.primaryRay(i, j, dx, dy);
+	ray.closestPt(scene.objects);
+	scene.countRay();
+	if (aovs != nullptr) aovs->writeHit(j * NUMDIV + i, scene, ray);
+	return ray;
+}
 
-	ray = Ray(eye, glm::vec3(xp + cellX * 0.75, yp + cellY * 0.75, -EDIST));
-	colour += trace(ray, 1);
 
-	colour *= glm::vec3(0.25);
-	return colour;
+// Returns the ambient occlusion at the hit of an intersected ray as a grey level
+// (black where the ray misses the scene).
+glm::vec3 occlusion(const Ray& ray)
+{
+	int samples = scene.aoSamples > 0 ? scene.aoSamples : 16;
+	if (ray.index == -1) return glm::vec3(0);
+	glm::vec3 normalVec = scene.objects[ray.index]->normal(ray.hit);
+	if (glm::dot(normalVec, ray.dir) > 0) normalVec = -normalVec;
+	return glm::vec3(scene.ambientOcclusion(ray.hit, normalVec, samples));
+}
+
+
+// Stores the ambient occlusion at the primary hit of every cell in 'frame'.
+void renderOcclusion(vector<glm::vec3>& frame, FrameBuffer* aovs)
+{
+	frame.assign(NUMDIV * NUMDIV, glm::vec3(0));
+	parallelFor(NUMDIV, [&](int j) {
+		for (int i = 0; i < NUMDIV; i++)
+		{
+			frame[j * NUMDIV + i] = occlusion(primaryHit(i, j, 0.5, 0.5, aovs));
+		}
+	});
+}
+
+
+// Returns the position of sample 'index' of 'count' within cell (i, j), placed by
+// the scene's sampler or, without one, uniformly at random.
+glm::vec2 cellSample(int i, int j, int index, int count)
+{
+	if (scene.sampler != nullptr) return scene.sampler->get2D(glm::ivec2(i, j), index, count, 0);
+	thread_local mt19937 rng(hash<thread::id>()(this_thread::get_id()));
+	uniform_real_distribution<float> uniform01(0.0f, 1.0f);
+	float dx = uniform01(rng);
+	return glm::vec2(dx, uniform01(rng));
+}
+
+
+// Renders the scene with adaptive sampling: every sample of the Whitted and ambient
+// occlusion renderers traces one primary ray through a random point of its cell.
+// The AOVs of a cell are recorded with its first sample.
+void renderAdaptive(vector<glm::vec3>& frame, FrameBuffer* aovs)
+{
+	adaptive.render(frame, [aovs](int i, int j, int index, int count) {
+		if (aovs != nullptr && index == 0) primaryHit(i, j, 0.5, 0.5, aovs); // AOVs of the cell centre
+		glm::vec2 d = cellSample(i, j, index, count);
+		Ray ray = primaryHit(i, j, d.x, d.y, nullptr);
+		return mode == AO ? occlusion(ray) : scene.shade(ray, 1);
+	});
+}
+
+
+// Traces every cell of the image plane with the selected renderer and stores its
+// colour in 'fb' (row major, NUMDIV x NUMDIV, starting from the bottom left cell),
+// along with the AOVs enabled in it.
+void renderImage(FrameBuffer& fb)
+{
+	vector<glm::vec3>& frame = fb.color;
+	FrameBuffer* aovs = fb.getChannels() != 0 ? &fb : nullptr;
+
+	if (mode == DEFERRED) {
+		deferred.render(frame, aovs);
+		return;
+	}
+	if (mode == WAVEFRONT) {
+		wavefront.render(frame, aovs);
+		return;
+	}
+
+	if (mode == PATH) {
+		pathTracer.render(frame, adaptiveSampling ? &adaptive : nullptr, aovs);
+		return;
+	}
+	if (adaptiveSampling) {
+		renderAdaptive(frame, aovs);
+		return;
+	}
+	if (mode == AO) {
+		renderOcclusion(frame, aovs);
+		return;
+	}
+	if (relighting) {
+		lightBuffers.render(frame, aovs);
+		return;
+	}
+	if (checkerboardRendering && aaSamples == 1) {
+		checkerboard.render(frame, aovs);
+		return;
+	}
+
+	auto pixel = [](int i, int j, FrameBuffer* aovs) {
+		if (aaSamples > 1) {
+			if (aovs != nullptr) primaryHit(i, j, 0.5, 0.5, aovs); // AOVs of the cell centre
+			return antiAliasing(i, j, aaSamples); // Anti-aliasing
+		}
+		Ray ray = primaryHit(i, j, 0.5, 0.5, aovs);
+		return scene.shade(ray, 1); // Get the colour value seen along the primary ray
+	};
+	if (incrementalRendering) {
+		incremental.render(fb, pixel);
+		return;
+	}
+
+	parallelFor(NUMDIV, [&](int j) { // Scan every cell of the image plane, one row per task
+		for (int i = 0; i < NUMDIV; i++)
+		{
+			frame[j * NUMDIV + i] = pixel(i, j, aovs);
+		}
+	});
+}
+
+
+// Renders a frame into 'fb' and, when enabled, accumulates and denoises it. Then
+// moves the camera on for the next frame.
+void renderFrame(FrameBuffer& fb)
+{
+	unsigned int channels = aovChannels | (denoising ? Denoiser::CHANNELS : 0)
+		| (temporalAccumulation ? TemporalAccumulator::CHANNELS : 0);
+	fb.resize(NUMDIV, NUMDIV, channels);
+	renderImage(fb);
+	if (temporalAccumulation) temporal.accumulate(fb);
+	if (denoising) denoiser.denoise(fb);
+	camera.setEye(camera.getEye() + cameraVelocity); // Next frame of the fly-through
+}
+
+
+// Writes the colour and AOVs of 'fb' to files, if requested.
+void saveAOVs(const FrameBuffer& fb)
+{
+	if (aovPrefix.empty()) return;
+	if (fb.save(aovPrefix)) clog << "Frame written to " << aovPrefix << ".*.pfm" << endl;
+	else cerr << "Could not write " << aovPrefix << ".*.pfm" << endl;
 }
 
 
@@ -191,7 +315,17 @@ void display()
 	float xp, yp; // grid point
 	float cellX = (XMAX - XMIN) / NUMDIV; // cell width
 	float cellY = (YMAX - YMIN) / NUMDIV; // cell height
-	glm::vec3 eye(0., 0., 0.);
+	static FrameBuffer fb;
+
+	if (lightsChanged) {
+		lightBuffers.relight(fb.color); // Only the light scales changed
+		lightsChanged = false;
+	}
+	else {
+		renderFrame(fb);
+		saveAOVs(fb);
+	}
+	const vector<glm::vec3>& frame = fb.color;
 
 	glClear(GL_COLOR_BUFFER_BIT);
 	glMatrixMode(GL_MODELVIEW);
@@ -199,19 +333,13 @@ void display()
 
 	glBegin(GL_QUADS); // Each cell is a tiny quad.
 
-	for (int i = 0; i < NUMDIV; i++) // Scan every cell of the image plane
+	for (int i = 0; i < NUMDIV; i++)
 	{
 		xp = XMIN + i * cellX;
 		for (int j = 0; j < NUMDIV; j++)
 		{
 			yp = YMIN + j * cellY;
-
-			glm::vec3 dir(xp + 0.5 * cellX, yp + 0.5 * cellY, -EDIST); // Direction of the primary ray
-
-			Ray ray = Ray(eye, dir);
-
-			//glm::vec3 col = antiAliasing(eye, cellX, cellY, xp, yp); //Anti-aliasing
-			glm::vec3 col = trace(ray, 1); // Trace the primary ray and get the colour value
+			glm::vec3 col = frame[j * NUMDIV + i];
 			glColor3f(col.r, col.g, col.b);
 			glVertex2f(xp, yp); // Draw each cell with its color value
 			glVertex2f(xp + cellX, yp);
@@ -225,16 +353,173 @@ void display()
 }
 
 
-// Creates scene objects and add them to the list of scene objects. Also, initializes the OpenGL 
-// orthographc projection matrix for drawing the the ray traced image.
-void initialize()
+// Returns the peak resident set size of the process in kilobytes.
+long peakRSS()
 {
-	texture = TextureBMP("GreenTexture.bmp");
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS pmc;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+		return (long)(pmc.PeakWorkingSetSize / 1024);
+	return 0;
+#else
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+	return usage.ru_maxrss / 1024; // Reported in bytes on macOS
+#else
+	return usage.ru_maxrss;
+#endif
+#endif
+}
 
-	glMatrixMode(GL_PROJECTION);
-	gluOrtho2D(XMIN, XMAX, YMIN, YMAX);
 
-	glClearColor(0, 0, 0, 1);
+// Edits the scene from the keyboard. In the incremental and checkerboard modes, o
+// selects the next object and c rotates the channels of its colour. In the relighting mode, keys 1-9
+// select a light, + and - make it brighter or darker and r, g and b strengthen one
+// colour channel of it.
+void keyboard(unsigned char key, int x, int y)
+{
+	bool editing = incrementalRendering || checkerboardRendering;
+	if (editing && key == 'o') {
+		selectedObject = (selectedObject + 1) % scene.objects.size();
+		return;
+	}
+	if (editing && key == 'c') {
+		SceneObject* obj = scene.objects[selectedObject];
+		glm::vec3 col = obj->getColor();
+		obj->setColor(glm::vec3(col.g, col.b, col.r));
+		incremental.invalidate(selectedObject);
+		checkerboard.invalidate(selectedObject);
+		glutPostRedisplay();
+		return;
+	}
+	if (!relighting) return;
+	if (key >= '1' && key <= '9') {
+		selectedLight = min(key - '1', lightBuffers.getLightCount() - 1);
+		return;
+	}
+	glm::vec3 scale = lightBuffers.getLightScale(selectedLight);
+	if (key == '+') scale *= 1.25f;
+	else if (key == '-') scale *= 0.8f;
+	else if (key == 'r') scale.r *= 1.25f;
+	else if (key == 'g') scale.g *= 1.25f;
+	else if (key == 'b') scale.b *= 1.25f;
+	else return;
+	lightBuffers.setLightScale(selectedLight, scale);
+	lightsChanged = true;
+	glutPostRedisplay();
+}
+
+
+// Renders the scene 'frames' times without opening a window and prints the frame
+// time statistics, ray throughput and peak memory use as a JSON object.
+void benchmark(int frames)
+{
+	FrameBuffer fb;
+	vector<double> times;
+	long long rays = 0;
+
+	renderFrame(fb); // Warm-up frame, not timed
+	for (int f = 0; f < frames; f++)
+	{
+		scene.resetRayCount();
+		incremental.invalidateAll(); // Frame times are those of full renders
+		auto start = chrono::steady_clock::now();
+		renderFrame(fb);
+		auto end = chrono::steady_clock::now();
+		times.push_back(chrono::duration<double, milli>(end - start).count());
+		rays += scene.getRayCount();
+	}
+	saveAOVs(fb);
+
+	double total = 0;
+	for (double t : times) total += t;
+	sort(times.begin(), times.end());
+	double median = (frames % 2) ? times[frames / 2] : 0.5 * (times[frames / 2 - 1] + times[frames / 2]);
+	double p95 = times[(int)ceil(0.95 * frames) - 1]; // Nearest-rank percentile
+
+	const char* modeNames[] = { "whitted", "deferred", "wavefront", "path", "ao" };
+	const char* layoutNames[] = { "rowmajor", "tiled", "streamed" };
+	double spp = mode == PATH ? pathTracer.getSamples() : (mode == WHITTED ? aaSamples : 1);
+	bool adaptiveMode = adaptiveSampling && (mode == WHITTED || mode == PATH || mode == AO);
+	if (adaptiveMode) spp = (double)adaptive.getTotalSamples() / (NUMDIV * NUMDIV); // Last frame
+	cout << "{\"scene\": \"builtin\", \"mode\": \"" << modeNames[mode] << "\", \"width\": " << NUMDIV << ", \"height\": " << NUMDIV
+		<< ", \"frames\": " << frames << ", \"threads\": " << getThreadCount() << ", \"spp\": " << spp
+		<< ", \"frame_ms\": {\"min\": " << times.front() << ", \"median\": " << median
+		<< ", \"p95\": " << p95 << ", \"mean\": " << total / frames << "}"
+		<< ", \"rays_per_frame\": " << rays / frames
+		<< ", \"mrays_per_s\": " << rays / (total * 1.e3)
+		<< ", \"samples_per_s\": " << (double)NUMDIV * NUMDIV * spp * frames / (total * 1.e-3)
+		<< ", \"texture_layout\": \"" << layoutNames[textureLayout] << "\"";
+	if (adaptiveMode) {
+		cout << ", \"adaptive\": {\"passes\": " << adaptive.getPasses()
+			<< ", \"converged\": " << (double)adaptive.getConvergedPixels() / (NUMDIV * NUMDIV) << "}";
+	}
+	if (temporalAccumulation) cout << ", \"history_reuse\": " << temporal.getReuse();
+	if (relighting) {
+		lightBuffers.setLightScale(0, glm::vec3(0.5, 0.8, 1.2)); // Time a change of light colour
+		auto start = chrono::steady_clock::now();
+		lightBuffers.relight(fb.color);
+		cout << ", \"relight_ms\": " << chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	}
+	if (mode == WHITTED && incrementalRendering && !adaptiveSampling && !relighting && !checkerboardRendering) {
+		// Time the update after an edit of each object in turn
+		double updateTime = 0, tiles = 0;
+		for (size_t k = 0; k < scene.objects.size(); k++)
+		{
+			scene.objects[k]->setColor(scene.objects[k]->getColor());
+			incremental.invalidate(k);
+			auto start = chrono::steady_clock::now();
+			renderFrame(fb);
+			updateTime += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+			tiles += (double)incremental.getRenderedTiles() / incremental.getTileCount();
+		}
+		cout << ", \"incremental\": {\"update_ms\": " << updateTime / scene.objects.size()
+			<< ", \"tiles\": " << tiles / scene.objects.size() << "}";
+	}
+	if (textureLayout == TextureBMP::STREAMED) {
+		long long lookups = textureCache.getHits() + textureCache.getMisses();
+		cout << ", \"texture_cache\": {\"hits\": " << textureCache.getHits() << ", \"misses\": " << textureCache.getMisses()
+			<< ", \"hit_rate\": " << (lookups > 0 ? (double)textureCache.getHits() / lookups : 0)
+			<< ", \"evictions\": " << textureCache.getEvictions()
+			<< ", \"resident_kb\": " << textureCache.getResidentBytes() / 1024 << "}";
+	}
+	if (mode == WHITTED && checkerboardRendering && aaSamples == 1 && !adaptiveSampling) {
+		cout << ", \"traced_pixels\": " << (double)checkerboard.getTracedPixels() / (NUMDIV * NUMDIV);
+	}
+	cout << ", \"peak_rss_kb\": " << peakRSS() << "}" << endl;
+}
+
+
+// Creates scene objects and add them to the list of scene objects.
+void initializeScene()
+{
+	if (softShadows) {
+		SphereLight* light = new SphereLight(glm::vec3(10, 40, -3), 4.0);
+		scene.lights.push_back(light);
+	}
+	else {
+		PointLight* light = new PointLight(glm::vec3(10, 40, -3));
+		scene.lights.push_back(light);
+	}
+
+	// Small coloured lights scattered over the scene, sharing the power of one light
+	mt19937 lightRng(7);
+	uniform_real_distribution<float> uni(0.0f, 1.0f);
+	for (int i = 0; i < extraLights; i++)
+	{
+		PointLight* light = new PointLight(glm::vec3(-50 + 100 * uni(lightRng), -10 + 50 * uni(lightRng),
+			-40 - 160 * uni(lightRng)));
+		light->setColor(glm::vec3(uni(lightRng), uni(lightRng), uni(lightRng)));
+		light->setIntensity(8.0f / extraLights);
+		light->setRadius(60);
+		scene.lights.push_back(light);
+	}
+	scene.buildLightTree();
+	if (relighting && scene.lights.size() > LightBufferRenderer::MAX_LIGHTS) {
+		cerr << "--relight supports up to " << LightBufferRenderer::MAX_LIGHTS << " lights; rendering without light buffers" << endl;
+		relighting = false;
+	}
 
 	Plane* plane = new Plane(glm::vec3(-50., -15, -40), 
 		glm::vec3(50., -15, -40),
@@ -242,39 +527,40 @@ void initialize()
 		glm::vec3(-50., -15, -200));
 	plane->setColor(glm::vec3(0.8, 0.8, 0));
 	plane->setSpecularity(false);
-	sceneObjects.push_back(plane);
+	scene.objects.push_back(plane);
 
 	Sphere* sphere1 = new Sphere(glm::vec3(-12.0, 0.0, -110.0), 15.0);
 	sphere1->setColor(glm::vec3(1, 0, 0));  
 	sphere1->setReflectivity(true, 0.8); 
-	sceneObjects.push_back(sphere1);		
+	scene.objects.push_back(sphere1);		
 
 	Sphere* sphere2 = new Sphere(glm::vec3(8.0, 8.0, -70.0), 3.0);
 	sphere2->setColor(glm::vec3(0, 0, 1));
 	sphere2->setTransparency(true, 0.3);
 	sphere2->setRefractivity(true, 0.8, 1.01);
-	sceneObjects.push_back(sphere2);
+	scene.objects.push_back(sphere2);
 
 	Sphere* sphere3 = new Sphere(glm::vec3(13.0, -2.0, -70.0), 4.0);
-	sceneObjects.push_back(sphere3);	
+	sphere3->setTexture(textureManager.load("GreenTexture.bmp", textureLayout));
+	scene.objects.push_back(sphere3);	
 
 	Sphere* sphere4 = new Sphere(glm::vec3(-8.0, 5.0, -70), 3.0);
 	sphere4->setColor(glm::vec3(0, 0, 1));
 	sphere4->setTransparency(true, 0.3);
 	sphere4->setRefractivity(true, 0.8, 1.01);
-	sceneObjects.push_back(sphere4);
+	scene.objects.push_back(sphere4);
 
 	Cylinder* cylinder = new Cylinder(glm::vec3(13.0, -15.0, -70.0), 3.0, 10.0);
 	cylinder->setColor(glm::vec3(1, 0, 0));
-	sceneObjects.push_back(cylinder);
+	scene.objects.push_back(cylinder);
 
 	Cone* cone = new Cone(glm::vec3(-8.0, -15.0, -70.0), 4.0, 12.0);
 	cone->setColor(glm::vec3(0.62, 0.12, 0.94));
-	sceneObjects.push_back(cone);
+	scene.objects.push_back(cone);
 
 	Cone* cone2 = new Cone(glm::vec3(8.0, -10.0, -100.0), 6.0, 16.0);
 	cone2->setColor(glm::vec3(0, 1, 0));
-	sceneObjects.push_back(cone2);
+	scene.objects.push_back(cone2);
 
 	Plane* wall = new Plane(glm::vec3(-50., -15, -200),
 		glm::vec3(50., -15, -200),
@@ -282,13 +568,149 @@ void initialize()
 		glm::vec3(-50., 50, -200));
 	wall->setColor(glm::vec3(0.95, 0.95, 0.95));
 	wall->setSpecularity(false);
-	sceneObjects.push_back(wall);
+	scene.objects.push_back(wall);
 
 	drawCube(-1.0, -15.0, -70.0, 8, glm::vec3(1, 0.45, 1));
+
+	if (photonCount > 0) scene.buildCausticMap(photonCount, photonRadius);
+}
+
+
+// Initializes the scene and the OpenGL orthographc projection matrix for drawing
+// the the ray traced image.
+void initialize()
+{
+	initializeScene();
+
+	glMatrixMode(GL_PROJECTION);
+	gluOrtho2D(XMIN, XMAX, YMIN, YMAX);
+
+	glClearColor(0, 0, 0, 1);
 }
 
 
 int main(int argc, char* argv[]) {
+	bool bench = false;
+	int frames = 10;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--bench") == 0) { // Headless benchmark mode: --bench [frames]
+			bench = true;
+			if (i + 1 < argc && isdigit(argv[i + 1][0])) frames = max(1, atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--mode") == 0 && i + 1 < argc) {
+			i++;
+			if (strcmp(argv[i], "whitted") == 0) mode = WHITTED;
+			else if (strcmp(argv[i], "deferred") == 0) mode = DEFERRED;
+			else if (strcmp(argv[i], "wavefront") == 0) mode = WAVEFRONT;
+			else if (strcmp(argv[i], "path") == 0) mode = PATH;
+			else if (strcmp(argv[i], "ao") == 0) mode = AO;
+			else cerr << "Unknown render mode: " << argv[i] << endl;
+		}
+		else if (strcmp(argv[i], "--soft-shadows") == 0) {
+			softShadows = true;
+		}
+		else if (strcmp(argv[i], "--lights") == 0 && i + 1 < argc) {
+			extraLights = max(0, atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--photons") == 0 && i + 1 < argc) {
+			photonCount = max(0, atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--photon-radius") == 0 && i + 1 < argc) {
+			photonRadius = max(0.01, atof(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--ao") == 0 && i + 1 < argc) { // --ao samples [radius]
+			scene.aoSamples = max(0, atoi(argv[++i]));
+			if (i + 1 < argc && (isdigit(argv[i + 1][0]) || argv[i + 1][0] == '.')) scene.aoRadius = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--sampler") == 0 && i + 1 < argc) {
+			i++;
+			if (strcmp(argv[i], "jittered") == 0) scene.sampler = new JitteredSampler();
+			else if (strcmp(argv[i], "sobol") == 0) scene.sampler = new SobolSampler();
+			else if (strcmp(argv[i], "bluenoise") == 0) scene.sampler = new BlueNoiseSampler();
+			else if (strcmp(argv[i], "lattice") == 0) scene.sampler = new LatticeSampler();
+			else if (strcmp(argv[i], "random") != 0) cerr << "Unknown sampler: " << argv[i] << endl;
+		}
+		else if (strcmp(argv[i], "--aa") == 0 && i + 1 < argc) {
+			aaSamples = max(1, atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--spp") == 0 && i + 1 < argc) {
+			pathTracer.setSamples(atoi(argv[i + 1]));
+			adaptive.setSamples(atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--adaptive") == 0) { // --adaptive [noise threshold]
+			adaptiveSampling = true;
+			if (i + 1 < argc && (isdigit(argv[i + 1][0]) || argv[i + 1][0] == '.')) adaptive.setThreshold(atof(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--denoise") == 0) { // --denoise [strength]
+			denoising = true;
+			if (i + 1 < argc && (isdigit(argv[i + 1][0]) || argv[i + 1][0] == '.')) denoiser.setStrength(atof(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--aov") == 0 && i + 1 < argc) { // --aov prefix [channels]
+			aovPrefix = argv[++i];
+			aovChannels = AOV_ALL;
+			if (i + 1 < argc && argv[i + 1][0] != '-') {
+				aovChannels = FrameBuffer::parseChannels(argv[++i]);
+				if (aovChannels == 0) cerr << "Unknown AOV channels: " << argv[i] << endl;
+			}
+		}
+		else if (strcmp(argv[i], "--temporal") == 0) { // --temporal [max history frames]
+			temporalAccumulation = true;
+			if (i + 1 < argc && isdigit(argv[i + 1][0])) temporal.setMaxHistory(atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--camera-velocity") == 0 && i + 3 < argc) { // Units per frame: x y z
+			cameraVelocity.x = atof(argv[++i]);
+			cameraVelocity.y = atof(argv[++i]);
+			cameraVelocity.z = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--incremental") == 0) {
+			incrementalRendering = true;
+		}
+		else if (strcmp(argv[i], "--texture-cache") == 0 && i + 1 < argc) { // --texture-cache budget in MB
+			textureLayout = TextureBMP::STREAMED;
+			textureCache.setBudget((size_t)(max(0.0, atof(argv[++i])) * (1 << 20)));
+		}
+		else if (strcmp(argv[i], "--texture-layout") == 0 && i + 1 < argc) {
+			i++;
+			if (strcmp(argv[i], "rowmajor") == 0) textureLayout = TextureBMP::ROW_MAJOR;
+			else if (strcmp(argv[i], "tiled") == 0) textureLayout = TextureBMP::TILED;
+			else if (strcmp(argv[i], "streamed") == 0) textureLayout = TextureBMP::STREAMED;
+			else cerr << "Unknown texture layout: " << argv[i] << endl;
+		}
+		else if (strcmp(argv[i], "--relight") == 0) {
+			relighting = true;
+		}
+		else if (strcmp(argv[i], "--checkerboard") == 0) {
+			checkerboardRendering = true;
+		}
+		else if (strcmp(argv[i], "--time-budget") == 0 && i + 1 < argc) {
+			adaptive.setTimeBudget(atof(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--bounces") == 0 && i + 1 < argc) {
+			pathTracer.setMaxBounces(atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--irradiance-cache") == 0) { // --irradiance-cache [accuracy]
+			float accuracy = 0.3;
+			if (i + 1 < argc && (isdigit(argv[i + 1][0]) || argv[i + 1][0] == '.')) accuracy = atof(argv[++i]);
+			pathTracer.setIrradianceCaching(true, accuracy);
+		}
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+			setThreadCount(max(0, atoi(argv[++i])));
+		}
+	}
+
+	// Other renderers and supersampling bypass the light buffers, so the relight keys would do nothing
+	if (relighting && (mode != WHITTED || aaSamples > 1 || adaptiveSampling)) {
+		cerr << "--relight needs the Whitted renderer without --aa or --adaptive; ignored" << endl;
+		relighting = false;
+	}
+
+	if (bench) {
+		initializeScene();
+		benchmark(frames);
+		return 0;
+	}
+
 	glutInit(&argc, argv);
 	glutInitDisplayMode(GLUT_SINGLE | GLUT_RGB);
 	glutInitWindowSize(600, 600);
@@ -296,6 +718,8 @@ int main(int argc, char* argv[]) {
 	glutCreateWindow("Raytracing");
 
 	glutDisplayFunc(display);
+	if (relighting || incrementalRendering || checkerboardRendering) glutKeyboardFunc(keyboard);
+	if (temporalAccumulation || cameraVelocity != glm::vec3(0)) glutIdleFunc(glutPostRedisplay); // Keep rendering frames
 	initialize();
 
 	glutMainLoop();
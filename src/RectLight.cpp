@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "RectLight.h"
+#include <math.h>
+
+glm::vec3 RectLight::samplePoint(float u, float v)
+{
+	return position + (u - 0.5f) * edgeU + (v - 0.5f) * edgeV;
+}
+
+float RectLight::intersect(glm::vec3 p0, glm::vec3 dir)
+{
+	glm::vec3 n = surfaceNormal(position);
+	float d_dot_n = glm::dot(dir, n);
+	if (fabs(d_dot_n) < 1.e-4) return -1; // Parallel ray
+	float t = glm::dot(position - p0, n) / d_dot_n;
+	if (t < 0) return -1;
+	glm::vec3 q = p0 + dir * t - position;
+	float u = glm::dot(q, edgeU) / glm::dot(edgeU, edgeU);
+	float v = glm::dot(q, edgeV) / glm::dot(edgeV, edgeV);
+	if (fabs(u) > 0.5 || fabs(v) > 0.5) return -1;
+	return t;
+}
+
+glm::vec3 RectLight::surfaceNormal(glm::vec3 x)
+{
+	return glm::normalize(glm::cross(edgeU, edgeV));
+}
+
+float RectLight::area()
+{
+	return glm::length(glm::cross(edgeU, edgeV));
+}
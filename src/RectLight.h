@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#ifndef H_RECTLIGHT
+#define H_RECTLIGHT
+#include <glm/glm.hpp>
+#include "AreaLight.h"
+
+/**
+ * Defines a rectangular light centered at 'position' and spanned by
+ * the edge vectors 'edgeU' and 'edgeV'.
+ */
+class RectLight : public AreaLight
+{
+
+private:
+	glm::vec3 edgeU = glm::vec3(1, 0, 0);
+	glm::vec3 edgeV = glm::vec3(0, 0, 1);
+
+public:
+	RectLight() {};
+
+	RectLight(glm::vec3 c, glm::vec3 eu, glm::vec3 ev) : AreaLight(c), edgeU(eu), edgeV(ev) {}
+
+	glm::vec3 samplePoint(float u, float v);
+
+	float intersect(glm::vec3 p0, glm::vec3 dir);
+
+	glm::vec3 surfaceNormal(glm::vec3 x);
+
+	float area();
+
+};
+
+#endif //!H_RECTLIGHT
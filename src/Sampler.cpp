@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "Sampler.h"
+#include <cstring>
+
+// Integer hash with good avalanche behaviour (lowbias32 by C. Wellons), applied
+// to the three inputs in turn.
+unsigned int Sampler::hash(unsigned int a, unsigned int b, unsigned int c)
+{
+	unsigned int h = a;
+	unsigned int inputs[3] = { b, c, 0x9E3779B9u };
+	for (int i = 0; i < 3; i++)
+	{
+		h ^= h >> 16; h *= 0x7FEB352Du;
+		h ^= h >> 15; h *= 0x846CA68Bu;
+		h ^= h >> 16;
+		h += inputs[i];
+	}
+	return h;
+}
+
+// Maps 32 random bits to a float in [0,1).
+float Sampler::toFloat(unsigned int bits)
+{
+	return (bits >> 8) * (1.0f / 16777216.0f);
+}
+
+glm::ivec2 Sampler::pointKey(glm::vec3 p)
+{
+	unsigned int bits[3];
+	memcpy(bits, &p, sizeof(bits));
+	return glm::ivec2(hash(bits[0], bits[1], bits[2]), hash(bits[2], bits[0], bits[1]));
+}
@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#ifndef H_SAMPLER
+#define H_SAMPLER
+#include <glm/glm.hpp>
+
+/**
+ * Generator of well distributed 2D sample points in [0,1)^2. A sampler has no
+ * state: sample 'index' of a set of 'count' points is a function of the pixel
+ * (or any other integer key) and the dimension, so it can be shared between
+ * render threads. Every dimension of a pixel is an independently randomised
+ * point set, and the 'count' points of one dimension are evenly spread.
+ */
+class Sampler
+{
+
+protected:
+	static unsigned int hash(unsigned int a, unsigned int b, unsigned int c);
+	static float toFloat(unsigned int bits);
+
+public:
+	virtual ~Sampler() {}
+
+	virtual glm::vec2 get2D(glm::ivec2 pixel, int index, int count, int dim) = 0;
+
+	/**
+	 * Key for sample sets that belong to a point in space rather than to a pixel.
+	 */
+	static glm::ivec2 pointKey(glm::vec3 p);
+
+};
+
+#endif //!H_SAMPLER
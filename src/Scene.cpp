@@ -0,0 +1,503 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "Scene.h"
+#include <math.h>
+#include <random>
+#include <algorithm>
+#include <thread>
+#include "Parallel.h"
+
+const int MAX_STEPS = 5;
+const float MIN_LIGHT_CONTRIBUTION = 1.0 / 255; // Lights contributing less than this are skipped
+const int SHADOW_STRATA = 2; // Initial area light shadow samples: SHADOW_STRATA x SHADOW_STRATA
+const int PENUMBRA_STRATA = 4; // Additional samples where the initial ones disagree
+const int MANY_LIGHTS = 16; // Above this many lights, shading samples lights from the light BVH
+const int LIGHT_SAMPLES = 4; // Lights sampled per shading point from the light BVH
+const int PHOTON_CHUNK = 4096; // Photons traced per parallel task
+
+namespace
+{
+	// Random numbers for stochastic sampling, one generator per render thread
+	thread_local std::mt19937 rng(std::hash<std::thread::id>()(std::this_thread::get_id()));
+	std::uniform_real_distribution<float> uniform01(0.0f, 1.0f);
+
+	// Rays counted by the calling thread, added to the scene's total when the thread
+	// exits (render threads live for one parallelFor task) or the total is read
+	struct RayTally
+	{
+		std::atomic<long long>* total = nullptr;
+		long long count = 0;
+
+		void flush()
+		{
+			if (total != nullptr && count != 0) *total += count;
+			count = 0;
+		}
+
+		~RayTally() { flush(); }
+	};
+	thread_local RayTally rayTally;
+}
+
+void Scene::countRay(long long n)
+{
+	if (rayTally.total != &rayCount) {
+		rayTally.flush();
+		rayTally.total = &rayCount;
+	}
+	rayTally.count += n;
+}
+
+long long Scene::getRayCount()
+{
+	if (rayTally.total == &rayCount) rayTally.flush();
+	return rayCount;
+}
+
+void Scene::resetRayCount()
+{
+	if (rayTally.total == &rayCount) rayTally.count = 0;
+	rayCount = 0;
+}
+
+// Builds the light BVH once the scene has too many lights to loop over at every hit.
+void Scene::buildLightTree()
+{
+	if (lights.size() > MANY_LIGHTS) lightTree.build(lights);
+}
+
+// Emits 'count' photons from the positioned lights towards the reflective and
+// refractive objects and stores those that reach a diffuse surface after at least
+// one specular reflection or refraction. Photons that pass straight through
+// transparent objects are already accounted for by shadow ray transmittance.
+// A photon carries the light's radiance at its first hit times the solid angle it
+// represents and its squared path length, so that, like the direct lighting, the
+// caustics have no distance falloff.
+void Scene::buildCausticMap(int count, float radius)
+{
+	struct Emitter { Light* light; glm::vec3 center; float radius; };
+	std::vector<Emitter> emitters;
+	for (Light* light : lights)
+	{
+		glm::vec3 pos, axis;
+		float thetaO, thetaE;
+		if (!light->emissionBounds(pos, axis, thetaO, thetaE)) continue; // Infinite lights emit no photons
+		for (SceneObject* obj : objects)
+		{
+			Emitter e;
+			if ((obj->isReflective() || obj->isRefractive()) && obj->boundingSphere(e.center, e.radius)) {
+				e.light = light;
+				emitters.push_back(e);
+			}
+		}
+	}
+	std::vector<Photon> stored;
+	if (emitters.empty() || count <= 0) {
+		causticMap.build(stored, radius);
+		return;
+	}
+
+	int perEmitter = std::max(1, count / (int)emitters.size());
+	int chunksPerEmitter = (perEmitter + PHOTON_CHUNK - 1) / PHOTON_CHUNK;
+	std::vector<std::vector<Photon>> chunkPhotons(emitters.size() * chunksPerEmitter);
+
+	parallelFor(chunkPhotons.size(), [&](int c) {
+		Emitter& e = emitters[c / chunksPerEmitter];
+		AreaLight* area = dynamic_cast<AreaLight*>(e.light);
+		PointLight* point = dynamic_cast<PointLight*>(e.light);
+		if (point == nullptr) return;
+		float areaRatio = area != nullptr ? area->area() / area->visibleArea() : 1;
+		std::minstd_rand chunkRng(c + 1);
+		auto rand01 = [&]() { return std::generate_canonical<float, 24>(chunkRng) * 0.99999994f; };
+		int begin = (c % chunksPerEmitter) * PHOTON_CHUNK;
+		int end = std::min(perEmitter, begin + PHOTON_CHUNK);
+
+		for (int k = begin; k < end; k++)
+		{
+			// Uniform direction within the cone around the object, from a point on the light
+			glm::vec3 origin = area != nullptr ? area->samplePoint(rand01(), rand01()) : point->getPosition();
+			glm::vec3 toObject = e.center - origin;
+			float dist = glm::length(toObject);
+			if (dist <= e.radius) continue;
+			float cosMax = sqrtf(1 - e.radius * e.radius / (dist * dist));
+			float solidAngle = 2 * 3.14159265f * (1 - cosMax);
+			float cosTheta = 1 - rand01() * (1 - cosMax);
+			float sinTheta = sqrtf(std::max(0.0f, 1 - cosTheta * cosTheta));
+			float phi = 2 * 3.14159265f * rand01();
+			glm::vec3 w = toObject / dist;
+			glm::vec3 t = fabs(w.x) > 0.5f ? glm::vec3(0, 1, 0) : glm::vec3(1, 0, 0);
+			glm::vec3 u = glm::normalize(glm::cross(w, t));
+			glm::vec3 v = glm::cross(w, u);
+			glm::vec3 dir = u * (sinTheta * cosf(phi)) + v * (sinTheta * sinf(phi)) + w * cosTheta;
+			if (area != nullptr && !area->isTwoSided() && glm::dot(dir, area->surfaceNormal(origin)) <= 0) continue;
+
+			Ray ray(origin, dir);
+			glm::vec3 power(solidAngle * areaRatio / perEmitter);
+			float pathLength = 0;
+			bool specular = false;
+			for (int step = 0; step < MAX_STEPS; step++)
+			{
+				ray.closestPt(objects);
+				if (ray.index == -1) break;
+				SceneObject* obj = objects[ray.index];
+				pathLength += ray.dist;
+				if (step == 0) {
+					glm::vec3 lightVec;
+					float lightDist;
+					power *= e.light->illuminate(ray.hit, lightVec, lightDist);
+				}
+
+				// Same lobe weights as the path tracer
+				float transparency = obj->isTransparent() ? obj->getTransparencyCoeff() : 0;
+				float wDiffuse = 1 - transparency;
+				float wReflect = obj->isReflective() ? obj->getReflectionCoeff() * (1 - transparency) : 0;
+				float wRefract = obj->isRefractive() ? obj->getRefractionCoeff() : 0;
+				float total = wDiffuse + wReflect + transparency + wRefract;
+				if (total <= 0) break;
+				float r = rand01() * total;
+				if (r < wDiffuse) {
+					if (specular) chunkPhotons[c].push_back({ ray.hit, power * pathLength * pathLength, ray.dir });
+					break;
+				}
+				glm::vec3 normalVec = obj->normal(ray.hit);
+				if (r < wDiffuse + wReflect) {
+					dir = glm::reflect(ray.dir, normalVec);
+					specular = true;
+				}
+				else if (r < wDiffuse + wReflect + transparency) {
+					dir = ray.dir;
+				}
+				else {
+					bool entering = glm::dot(ray.dir, normalVec) < 0;
+					glm::vec3 n = entering ? normalVec : -normalVec;
+					float eta = entering ? 1 / obj->getRefractiveIndex() : obj->getRefractiveIndex();
+					dir = glm::refract(ray.dir, n, eta);
+					if (glm::dot(dir, dir) < 1.e-6) dir = glm::reflect(ray.dir, n); // Total internal reflection
+					specular = true;
+				}
+				power *= total;
+				ray = Ray(ray.hit, dir);
+			}
+		}
+	});
+
+	for (std::vector<Photon>& chunk : chunkPhotons)
+	{
+		stored.insert(stored.end(), chunk.begin(), chunk.end());
+	}
+	causticMap.build(stored, radius);
+}
+
+// Light focused onto a diffuse surface of colour 'col' by specular objects.
+glm::vec3 Scene::caustics(glm::vec3 col, glm::vec3 hit, glm::vec3 normalVec)
+{
+	if (causticMap.size() == 0) return glm::vec3(0);
+	return col * causticMap.irradiance(hit, normalVec);
+}
+
+// Surface parameterisation of object 'index' at 'hit': that of the object itself,
+// except for the chequered floor (object 0), whose pattern is laid out in world
+// units by the x and z coordinates.
+glm::vec2 Scene::textureCoords(int index, glm::vec3 hit)
+{
+	if (index == 0) {
+		return glm::vec2(hit.x, hit.z);
+	}
+	return objects[index]->textureCoords(hit);
+}
+
+// Colour of object 'index' at the texture coordinates 'uv'. Textures are filtered over
+// the footprint spanned by the offsets 'duvdx' and 'duvdy', if given, and otherwise
+// sampled at the nearest texel.
+glm::vec3 Scene::surfaceColor(int index, glm::vec2 uv, glm::vec2 duvdx, glm::vec2 duvdy)
+{
+	if (index == 0) {
+		// Chequered pattern
+		int stripeWidth = 5;
+		int iz = (uv.y + 100) / stripeWidth;
+		int ix = (uv.x + 100) / stripeWidth;
+		int k = iz % 2; // 2 colors
+		int j = ix % 2;
+		if ((k && j) || (!k && !j)) {
+			return glm::vec3(0, 1, 0);
+		}
+		return glm::vec3(1, 1, 0.5);
+	}
+
+	TextureBMP* texture = objects[index]->getTexture();
+	if (texture != nullptr) {
+		if (duvdx == glm::vec2(0) && duvdy == glm::vec2(0)) return texture->getColorAt(uv.x, uv.y);
+		duvdx -= glm::round(duvdx); // Coordinates such as longitudes wrap around
+		duvdy -= glm::round(duvdy);
+		return texture->getColorAt(uv.x, uv.y, duvdx, duvdy);
+	}
+
+	return objects[index]->getColor();
+}
+
+// Colour of the surface hit by 'ray' at the texture coordinates 'uv', with textures
+// filtered over the footprint of the ray's differentials on the surface.
+glm::vec3 Scene::surfaceColor(const Ray& ray, glm::vec2 uv, glm::vec3 normalVec)
+{
+	if (!ray.hasDifferentials) return surfaceColor(ray.index, uv);
+	glm::vec3 dHdx, dHdy;
+	ray.hitDifferentials(normalVec, dHdx, dHdy);
+	return surfaceColor(ray.index, uv, textureCoords(ray.index, ray.hit + dHdx) - uv,
+		textureCoords(ray.index, ray.hit + dHdy) - uv);
+}
+
+// Returns the fraction of the light reaching 'hit' from a light source 'lightDist' away
+// in the direction 'lightVec'.
+float Scene::shadowVisibility(glm::vec3 hit, glm::vec3 lightVec, float lightDist)
+{
+	Ray shadowRay(hit, lightVec); // Shadow ray at the point of intersection
+	countRay();
+	return shadowRay.transmittance(objects, lightDist);
+}
+
+// Fraction of 'samples' cosine-weighted rays from 'hit' that leave the hemisphere
+// around 'normalVec' without meeting an object within 'aoRadius'. Returns 1 when
+// 'samples' is zero. The rays come from the scene's sampler, or else are stratified
+// in their angle from the normal.
+float Scene::ambientOcclusion(glm::vec3 hit, glm::vec3 normalVec, int samples)
+{
+	if (samples <= 0) return 1;
+	glm::vec3 t = fabs(normalVec.x) > 0.5f ? glm::vec3(0, 1, 0) : glm::vec3(1, 0, 0);
+	glm::vec3 b1 = glm::normalize(glm::cross(normalVec, t));
+	glm::vec3 b2 = glm::cross(normalVec, b1);
+	int open = 0;
+	glm::ivec2 key = sampler != nullptr ? Sampler::pointKey(hit) : glm::ivec2(0);
+	for (int s = 0; s < samples; s++)
+	{
+		float u, phi;
+		if (sampler != nullptr) {
+			glm::vec2 uv = sampler->get2D(key, s, samples, 0);
+			u = uv.x;
+			phi = 2 * 3.14159265f * uv.y;
+		}
+		else {
+			u = (s + uniform01(rng)) / samples;
+			phi = 2 * 3.14159265f * uniform01(rng);
+		}
+		float r = sqrtf(u);
+		glm::vec3 dir = b1 * (r * cosf(phi)) + b2 * (r * sinf(phi)) + normalVec * sqrtf(1 - u);
+		Ray aoRay(hit, dir);
+		countRay();
+		if (!aoRay.occluded(objects, aoRadius)) open++;
+	}
+	return (float)open / samples;
+}
+
+// Casts one jittered shadow ray into each of the 'strata' x 'strata' cells of the surface
+// of 'light' and returns the sum of their transmittances. 'lo' and 'hi' are updated with
+// the smallest and largest transmittance seen.
+float Scene::sampleAreaLight(glm::vec3 hit, AreaLight* light, int strata, float& lo, float& hi)
+{
+	float sum = 0;
+	glm::ivec2 key = sampler != nullptr ? Sampler::pointKey(hit) : glm::ivec2(0);
+	for (int i = 0; i < strata; i++)
+	{
+		for (int j = 0; j < strata; j++)
+		{
+			float u, v;
+			if (sampler != nullptr) {
+				glm::vec2 uv = sampler->get2D(key, i * strata + j, strata * strata, strata); // One set per pass
+				u = uv.x;
+				v = uv.y;
+			}
+			else {
+				u = (i + uniform01(rng)) / strata;
+				v = (j + uniform01(rng)) / strata;
+			}
+			glm::vec3 lightVec = light->samplePoint(u, v) - hit;
+			float lightDist = glm::length(lightVec);
+			float visibility = shadowVisibility(hit, lightVec / lightDist, lightDist);
+			lo = std::min(lo, visibility);
+			hi = std::max(hi, visibility);
+			sum += visibility;
+		}
+	}
+	return sum;
+}
+
+// Soft shadow visibility of an area light. A few stratified samples are taken first;
+// only if they disagree (the point lies in the penumbra) is the light sampled densely.
+float Scene::softShadowVisibility(glm::vec3 hit, AreaLight* light)
+{
+	int n = SHADOW_STRATA * SHADOW_STRATA;
+	float lo = 1, hi = 0;
+	float sum = sampleAreaLight(hit, light, SHADOW_STRATA, lo, hi);
+	if (lo == hi) return lo; // All samples agree: not in the penumbra
+
+	int m = PENUMBRA_STRATA * PENUMBRA_STRATA;
+	sum += sampleAreaLight(hit, light, PENUMBRA_STRATA, lo, hi);
+	return sum / (n + m);
+}
+
+// Fraction of 'light' visible from 'hit', where the light arrives from 'lightVec' with
+// 'radiance' at an angle of cosine 'lDotn' to the surface normal. The shadow ray is
+// skipped, and zero returned, when the surface faces away from the light or the
+// light's contribution is negligible.
+float Scene::lightVisibility(Light* light, glm::vec3 hit, glm::vec3 lightVec, float lightDist,
+	float lDotn, glm::vec3 radiance)
+{
+	if (lDotn <= 0) return 0; // Facing away from the light: no shadow ray needed
+	if (lDotn * glm::max(radiance.r, glm::max(radiance.g, radiance.b)) < MIN_LIGHT_CONTRIBUTION) return 0;
+	AreaLight* area = dynamic_cast<AreaLight*>(light);
+	return area ? softShadowVisibility(hit, area) : shadowVisibility(hit, lightVec, lightDist);
+}
+
+// Light reflected towards 'viewVec' at the point 'hit' of 'obj' (with surface colour 'col')
+// from a single light whose radiance is scaled by 'scale', including its shadow.
+glm::vec3 Scene::lightContribution(SceneObject* obj, glm::vec3 col, Light* light, glm::vec3 hit,
+	glm::vec3 viewVec, glm::vec3 normalVec, float scale)
+{
+	glm::vec3 lightVec; // Unit vector from the point of intersection to the light source
+	float lightDist; // Distance to the light source
+	glm::vec3 radiance = scale * light->illuminate(hit, lightVec, lightDist);
+	float lDotn = glm::dot(lightVec, normalVec);
+	float visibility = lightVisibility(light, hit, lightVec, lightDist, lDotn, radiance);
+	if (visibility <= 0) return glm::vec3(0);
+	return visibility * radiance * obj->directLighting(lightVec, viewVec, normalVec, col);
+}
+
+// Light reflected towards 'viewVec' at the point 'hit' of 'obj' from all lights of the scene.
+glm::vec3 Scene::directLighting(SceneObject* obj, glm::vec3 col, glm::vec3 hit, glm::vec3 viewVec,
+	glm::vec3 normalVec)
+{
+	glm::vec3 color(0);
+	if (lightTree.size() > 0) {
+		// Many lights: pick a few in proportion to their estimated contribution, and
+		// weight each by the inverse of its selection probability
+		for (int i = 0; i < LIGHT_SAMPLES; i++)
+		{
+			float pdf;
+			Light* light = lightTree.sample(hit, normalVec, uniform01(rng), pdf);
+			if (light == nullptr) break;
+			color += lightContribution(obj, col, light, hit, viewVec, normalVec, 1.0f / (pdf * LIGHT_SAMPLES));
+		}
+		for (Light* light : lightTree.getInfiniteLights()) // Directional lights are not in the tree
+		{
+			color += lightContribution(obj, col, light, hit, viewVec, normalVec, 1.0f);
+		}
+	}
+	else {
+		for (Light* light : lights)
+		{
+			color += lightContribution(obj, col, light, hit, viewVec, normalVec, 1.0f);
+		}
+	}
+	return color;
+}
+
+// Blend factor of the fog at the point 'hit'. Not clamped: points beyond the far
+// end of the fog get a factor above one.
+float Scene::fogFactor(glm::vec3 hit)
+{
+	int z1 = -70;
+	int z2 = -150;
+	return (hit.z - z1) / (z2 - z1);
+}
+
+// Blends 'color' towards white with the depth of the point 'hit'.
+glm::vec3 Scene::fog(glm::vec3 color, glm::vec3 hit)
+{
+	float t = fogFactor(hit);
+	return (1 - t) * color + glm::vec3(t, t, t);
+}
+
+// Adds the reflected and refracted light to the 'color' of the point of intersection
+// of 'ray' with 'obj', and applies the object's transparency.
+glm::vec3 Scene::secondaryRays(SceneObject* obj, glm::vec3 color, Ray& ray, glm::vec3 normalVec, int step)
+{
+	if (obj->isReflective() && step < MAX_STEPS) {
+		float rho = obj->getReflectionCoeff();
+		glm::vec3 reflectedDir = glm::reflect(ray.dir, normalVec);
+		Ray reflectedRay(ray.hit, reflectedDir);
+		reflectedRay.reflectDifferentials(ray, obj, normalVec);
+		glm::vec3 reflectedColor = trace(reflectedRay, step + 1);
+		color = color + (rho * reflectedColor);
+	}
+
+	if (obj->isTransparent() && step < MAX_STEPS) {
+		float tho = obj->getTransparencyCoeff();
+		color = color * (1 - tho);
+	}
+
+	if (obj->isRefractive() && step < MAX_STEPS)
+	{
+		float rho = obj->getRefractionCoeff();
+		float refractiveIndex = obj->getRefractiveIndex();
+		float eta = 1 / refractiveIndex;
+		glm::vec3 n = normalVec;
+		glm::vec3 g = glm::refract(ray.dir, n, eta);
+		Ray refrRay(ray.hit, g);
+		refrRay.refractDifferentials(ray, obj, n, eta);
+		refrRay.closestPt(objects);
+		countRay();
+		glm::vec3 m = obj->normal(refrRay.hit);
+		glm::vec3 h = glm::refract(g, -m, 1.0f / eta);
+		Ray r(refrRay.hit, h);
+		r.refractDifferentials(refrRay, obj, -m, 1.0f / eta);
+		glm::vec3 refractedColor = trace(r, step + 1);
+		color = color + (rho * refractedColor);
+	}
+
+	return color;
+}
+
+// Computes the colour value obtained by tracing a ray and finding its 
+// closest point of intersection with objects in the scene.
+glm::vec3 Scene::trace(Ray ray, int step)
+{
+	ray.closestPt(objects); // Compare the ray with all objects in the scene
+	countRay();
+	return shade(ray, step);
+}
+
+// Colour seen along a ray that has already been intersected with the scene, from
+// the shading at its hit alone: the ambient term and the direct light of every
+// light without shadows, caustics and fog. Traces no further rays.
+glm::vec3 Scene::localShading(const Ray& ray)
+{
+	if (ray.index == -1) return glm::vec3(0);
+	SceneObject* obj = objects[ray.index];
+	glm::vec3 normalVec = obj->normal(ray.hit);
+	glm::vec3 col = surfaceColor(ray, textureCoords(ray.index, ray.hit), normalVec);
+	glm::vec3 color = obj->ambient(col);
+	for (Light* light : lights)
+	{
+		glm::vec3 lightVec;
+		float lightDist;
+		glm::vec3 radiance = light->illuminate(ray.hit, lightVec, lightDist);
+		if (glm::dot(lightVec, normalVec) > 0) color += radiance * obj->directLighting(lightVec, -ray.dir, normalVec, col);
+	}
+	color += caustics(col, ray.hit, normalVec);
+	return fog(color, ray.hit);
+}
+
+// Computes the colour value seen along a ray that has already been intersected
+// with the scene.
+glm::vec3 Scene::shade(Ray ray, int step)
+{
+	glm::vec3 backgroundCol(0);	// Background colour = (0,0,0)
+	glm::vec3 color(0);
+	SceneObject* obj;
+
+	if (ray.index == -1) return backgroundCol; // No intersection
+	obj = objects[ray.index]; // Object on which the closest point of intersection is found
+
+	glm::vec3 normalVec = obj->normal(ray.hit);
+	glm::vec3 col = surfaceColor(ray, textureCoords(ray.index, ray.hit), normalVec);
+	float ao = ambientOcclusion(ray.hit, glm::dot(normalVec, ray.dir) > 0 ? -normalVec : normalVec, aoSamples);
+	color = ao * obj->ambient(col) + directLighting(obj, col, ray.hit, -ray.dir, normalVec); // Object's lighting
+	color += caustics(col, ray.hit, normalVec);
+	color = fog(color, ray.hit);
+
+	return secondaryRays(obj, color, ray, normalVec, step);
+}
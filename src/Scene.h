@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#ifndef H_SCENE
+#define H_SCENE
+#include <glm/glm.hpp>
+#include <vector>
+#include <atomic>
+#include "SceneObject.h"
+#include "Ray.h"
+#include "Light.h"
+#include "AreaLight.h"
+#include "LightBVH.h"
+#include "PhotonMap.h"
+#include "Sampler.h"
+#include "TextureBMP.h"
+
+/**
+ * The objects and lights of a scene, together with the Whitted style shading
+ * used by every renderer: surface patterns, direct lighting with shadows,
+ * fog and recursive reflection and refraction.
+ */
+class Scene
+{
+
+private:
+	std::atomic<long long> rayCount{0}; // Rays counted by threads that have finished their task
+
+	float sampleAreaLight(glm::vec3 hit, AreaLight* light, int strata, float& lo, float& hi);
+
+public:
+	std::vector<SceneObject*> objects;
+	std::vector<Light*> lights;
+	LightBVH lightTree; // Hierarchy over the positioned lights, built only for scenes with many lights
+	PhotonMap causticMap; // Photons that reached a diffuse surface by specular reflection or refraction
+	Sampler* sampler = nullptr; // Sample point generator, or nullptr for independent random samples
+	int aoSamples = 0; // Ambient occlusion rays per shading point, 0 = flat ambient term
+	float aoRadius = 10; // Distance within which objects occlude
+
+	Scene() {}
+
+	void buildLightTree();
+
+	/**
+	 * Counts 'n' rays intersected with the scene, for benchmarking. Each thread counts
+	 * into its own tally, which is added to the total once, when the thread ends its
+	 * task, so rays are counted without contention.
+	 */
+	void countRay(long long n = 1);
+
+	/**
+	 * Number of rays counted since the last reset. Call from the thread that started
+	 * the render, once its parallel tasks have returned.
+	 */
+	long long getRayCount();
+
+	void resetRayCount();
+
+	void buildCausticMap(int count, float radius);
+
+	glm::vec3 caustics(glm::vec3 col, glm::vec3 hit, glm::vec3 normalVec);
+
+	glm::vec2 textureCoords(int index, glm::vec3 hit);
+
+	glm::vec3 surfaceColor(int index, glm::vec2 uv, glm::vec2 duvdx = glm::vec2(0), glm::vec2 duvdy = glm::vec2(0));
+
+	glm::vec3 surfaceColor(const Ray& ray, glm::vec2 uv, glm::vec3 normalVec);
+
+	float shadowVisibility(glm::vec3 hit, glm::vec3 lightVec, float lightDist);
+
+	float softShadowVisibility(glm::vec3 hit, AreaLight* light);
+
+	float ambientOcclusion(glm::vec3 hit, glm::vec3 normalVec, int samples);
+
+	float lightVisibility(Light* light, glm::vec3 hit, glm::vec3 lightVec, float lightDist,
+		float lDotn, glm::vec3 radiance);
+
+	glm::vec3 lightContribution(SceneObject* obj, glm::vec3 col, Light* light, glm::vec3 hit,
+		glm::vec3 viewVec, glm::vec3 normalVec, float scale);
+
+	glm::vec3 directLighting(SceneObject* obj, glm::vec3 col, glm::vec3 hit, glm::vec3 viewVec,
+		glm::vec3 normalVec);
+
+	float fogFactor(glm::vec3 hit);
+
+	glm::vec3 fog(glm::vec3 color, glm::vec3 hit);
+
+	glm::vec3 secondaryRays(SceneObject* obj, glm::vec3 color, Ray& ray, glm::vec3 normalVec, int step);
+
+	glm::vec3 localShading(const Ray& ray);
+
+	glm::vec3 shade(Ray ray, int step);
+
+	glm::vec3 trace(Ray ray, int step);
+
+};
+
+#endif //!H_SCENE
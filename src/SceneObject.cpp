@@ -12,23 +12,51 @@ glm::vec3 SceneObject::getColor()
 	return color_;
 }
 
+// Lighting from a single white point light at 'lightPos', including the ambient term.
 glm::vec3 SceneObject::lighting(glm::vec3 lightPos, glm::vec3 viewVec, glm::vec3 hit)
 {
-	float ambientTerm = 0.2;
-	float diffuseTerm = 0;
-	float specularTerm = 0;
 	glm::vec3 normalVec = normal(hit);
 	glm::vec3 lightVec = lightPos - hit;
 	lightVec = glm::normalize(lightVec);
+	return ambient(color_) + directLighting(lightVec, viewVec, normalVec, color_);
+}
+
+// Sphere enclosing the object, used to aim photons at it. Returns false for
+// objects without a finite bound.
+bool SceneObject::boundingSphere(glm::vec3& center, float& radius)
+{
+	return false;
+}
+
+// Texture coordinates of the point 'pos' on the surface, in [0,1]. Objects without
+// a parameterisation map their whole surface to (0, 0).
+glm::vec2 SceneObject::textureCoords(glm::vec3 pos)
+{
+	return glm::vec2(0);
+}
+
+// Ambient reflection of the material, for a surface of colour 'col'.
+glm::vec3 SceneObject::ambient(glm::vec3 col)
+{
+	float ambientTerm = 0.2;
+	return ambientTerm * col;
+}
+
+// Diffuse and specular reflection of a unit strength light arriving from the unit
+// direction 'lightVec', for a surface of colour 'col' (which may vary over the
+// object). Returns zero when the surface faces away from the light.
+glm::vec3 SceneObject::directLighting(glm::vec3 lightVec, glm::vec3 viewVec, glm::vec3 normalVec, glm::vec3 col)
+{
+	float specularTerm = 0;
 	float lDotn = glm::dot(lightVec, normalVec);
+	if (lDotn <= 0) return glm::vec3(0);
 	if (spec_)
 	{
 		glm::vec3 reflVec = glm::reflect(-lightVec, normalVec);
 		float rDotv = glm::dot(reflVec, viewVec);
 		if (rDotv > 0) specularTerm = pow(rDotv, shin_);
 	}
-	glm::vec3 colorSum = ambientTerm * color_ + lDotn * color_ + specularTerm * glm::vec3(1);
-	return colorSum;
+	return lDotn * col + specularTerm * glm::vec3(1);
 }
 
 float SceneObject::getReflectionCoeff()
@@ -56,6 +84,12 @@ float SceneObject::getShininess()
 	return shin_;
 }
 
+// Texture of the material, or nullptr for none. The object keeps it loaded.
+TextureBMP* SceneObject::getTexture()
+{
+	return texture_.get();
+}
+
 bool SceneObject::isReflective()
 {
 	return refl_;
@@ -125,4 +159,9 @@ void SceneObject::setTransparency(bool flag, float tran_coeff)
 {
 	tran_ = flag;
 	tranc_ = tran_coeff;
-}
\ No newline at end of file
+}
+
+void SceneObject::setTexture(std::shared_ptr<TextureBMP> texture)
+{
+	texture_ = texture;
+}
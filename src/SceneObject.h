@@ -8,6 +8,9 @@
 #ifndef H_SOBJECT
 #define H_SOBJECT
 #include <glm/glm.hpp>
+#include <memory>
+
+class TextureBMP;
 
 
 class SceneObject 
@@ -23,13 +26,18 @@ protected:
 	float tranc_ = 0.8; // Coefficient of transparency
 	float refri_ = 1.0; // Refractive index
 	float shin_ = 50.0; // Shininess
+	std::shared_ptr<TextureBMP> texture_; // Texture of the material, shared with other objects
 public:
 	SceneObject() {}
     virtual float intersect(glm::vec3 p0, glm::vec3 dir) = 0;
 	virtual glm::vec3 normal(glm::vec3 pos) = 0;
+	virtual bool boundingSphere(glm::vec3& center, float& radius);
+	virtual glm::vec2 textureCoords(glm::vec3 pos);
 	virtual ~SceneObject() {}
 
 	glm::vec3 lighting(glm::vec3 lightPos, glm::vec3 viewVec, glm::vec3 hit);
+	glm::vec3 ambient(glm::vec3 col);
+	glm::vec3 directLighting(glm::vec3 lightVec, glm::vec3 viewVec, glm::vec3 normalVec, glm::vec3 col);
 	void setColor(glm::vec3 col);
 	void setReflectivity(bool flag);
 	void setReflectivity(bool flag, float refl_coeff);
@@ -39,12 +47,14 @@ public:
 	void setSpecularity(bool flag);
 	void setTransparency(bool flag);
 	void setTransparency(bool flag, float tran_coeff);
+	void setTexture(std::shared_ptr<TextureBMP> texture);
 	glm::vec3 getColor();
 	float getReflectionCoeff();
 	float getRefractionCoeff();
 	float getTransparencyCoeff();
 	float getRefractiveIndex();
 	float getShininess();
+	TextureBMP* getTexture();
 	bool isReflective();
 	bool isRefractive();
 	bool isSpecular();
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "SobolSampler.h"
+
+namespace
+{
+	unsigned int reverseBits(unsigned int x)
+	{
+		x = (x << 16) | (x >> 16);
+		x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+		x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+		x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+		x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+		return x;
+	}
+
+	// Random permutation of the bits of 'x' that only depends on the bits below each
+	// bit, i.e. an Owen scramble in reversed bit order (Laine and Karras)
+	unsigned int laineKarras(unsigned int x, unsigned int seed)
+	{
+		x += seed;
+		x ^= x * 0x6c50b47cu;
+		x ^= x * 0xb82f1e52u;
+		x ^= x * 0xc7afe638u;
+		x ^= x * 0x8d22f6e6u;
+		return x;
+	}
+
+	unsigned int owenScramble(unsigned int x, unsigned int seed)
+	{
+		return reverseBits(laineKarras(reverseBits(x), seed));
+	}
+}
+
+// Builds the generator matrices: the identity in bit reversed order (van der
+// Corput) and the matrix of the second Sobol dimension (primitive polynomial x + 1).
+SobolSampler::SobolSampler()
+{
+	unsigned int v = 1u << 31;
+	for (int k = 0; k < 32; k++)
+	{
+		matrix[0][k] = 1u << (31 - k);
+		matrix[1][k] = v;
+		v ^= v >> 1;
+	}
+}
+
+unsigned int SobolSampler::sobol(unsigned int index, int d)
+{
+	unsigned int x = 0;
+	for (int k = 0; index != 0; index >>= 1, k++)
+	{
+		if (index & 1) x ^= matrix[d][k];
+	}
+	return x;
+}
+
+glm::vec2 SobolSampler::get2D(glm::ivec2 pixel, int index, int count, int dim)
+{
+	unsigned int seed = hash(pixel.x, pixel.y, dim);
+	unsigned int shuffled = owenScramble(index, seed);
+	unsigned int x = owenScramble(sobol(shuffled, 0), hash(seed, 1, 0));
+	unsigned int y = owenScramble(sobol(shuffled, 1), hash(seed, 2, 0));
+	return glm::vec2(toFloat(x), toFloat(y));
+}
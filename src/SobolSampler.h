@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#ifndef H_SOBOLSAMPLER
+#define H_SOBOLSAMPLER
+#include "Sampler.h"
+
+/**
+ * The first two dimensions of the Sobol sequence with hash-based Owen scrambling
+ * (Burley, "Practical Hash-based Owen Scrambling"). Each pixel and dimension
+ * shuffles the point order and scrambles both coordinates with its own seeds, so
+ * higher dimensions are padded with independent scrambled 2D point sets. Point
+ * sets of power of two size are best.
+ */
+class SobolSampler : public Sampler
+{
+
+private:
+	unsigned int matrix[2][32]; // Generator matrices, as columns
+
+	unsigned int sobol(unsigned int index, int d);
+
+public:
+	SobolSampler();
+
+	glm::vec2 get2D(glm::ivec2 pixel, int index, int count, int dim);
+
+};
+
+#endif //!H_SOBOLSAMPLER
@@ -41,3 +41,21 @@ glm::vec3 Sphere::normal(glm::vec3 p)
     n = glm::normalize(n);
     return n;
 }
+
+bool Sphere::boundingSphere(glm::vec3& c, float& r)
+{
+	c = center;
+	r = radius;
+	return true;
+}
+
+/**
+* Texture coordinates of a point on the sphere: its longitude and latitude.
+*/
+glm::vec2 Sphere::textureCoords(glm::vec3 p)
+{
+	glm::vec3 n = normal(p);
+	float s = (0.5 - atan2(n.z, n.x) + 3.14) / (2 * 3.14);
+	float t = 0.5 + asin(glm::clamp(n.y, -1.0f, 1.0f)) / 3.14;
+	return glm::vec2(s, t);
+}
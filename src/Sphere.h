@@ -30,6 +30,10 @@ public:
 
 	glm::vec3 normal(glm::vec3 p);
 
+	glm::vec2 textureCoords(glm::vec3 p);
+
+	bool boundingSphere(glm::vec3& c, float& r);
+
 };
 
 #endif // !H_SPHERE
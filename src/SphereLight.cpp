@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "SphereLight.h"
+#include <math.h>
+
+/**
+* Maps (u, v) uniformly onto the surface of the sphere.
+*/
+glm::vec3 SphereLight::samplePoint(float u, float v)
+{
+	const float PI = 3.14159265f;
+	float z = 1 - 2 * u;
+	float r = sqrt(fmax(0.0f, 1 - z * z));
+	float phi = 2 * PI * v;
+	return position + sphereRadius * glm::vec3(r * cosf(phi), r * sinf(phi), z);
+}
+
+float SphereLight::intersect(glm::vec3 p0, glm::vec3 dir)
+{
+	glm::vec3 vdif = p0 - position;
+	float b = glm::dot(dir, vdif);
+	float c = glm::dot(vdif, vdif) - sphereRadius * sphereRadius;
+	float delta = b * b - c;
+	if (delta < 0) return -1;
+	float t1 = -b - sqrt(delta);
+	float t2 = -b + sqrt(delta);
+	if (t1 < 0) return (t2 > 0) ? t2 : -1;
+	return t1;
+}
+
+glm::vec3 SphereLight::surfaceNormal(glm::vec3 x)
+{
+	return glm::normalize(x - position);
+}
+
+float SphereLight::area()
+{
+	const float PI = 3.14159265f;
+	return 4 * PI * sphereRadius * sphereRadius;
+}
+
+/**
+* Only the hemisphere facing a distant point is visible from it.
+*/
+float SphereLight::visibleArea()
+{
+	return 0.5f * area();
+}
+
+bool SphereLight::isTwoSided()
+{
+	return false;
+}
@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#ifndef H_SPHERELIGHT
+#define H_SPHERELIGHT
+#include <glm/glm.hpp>
+#include "AreaLight.h"
+
+/**
+ * Defines a spherical light centered at 'position' with the specified radius.
+ */
+class SphereLight : public AreaLight
+{
+
+private:
+	float sphereRadius = 1;
+
+public:
+	SphereLight() {};
+
+	SphereLight(glm::vec3 c, float r) : AreaLight(c), sphereRadius(r) {}
+
+	glm::vec3 samplePoint(float u, float v);
+
+	float intersect(glm::vec3 p0, glm::vec3 dir);
+
+	glm::vec3 surfaceNormal(glm::vec3 x);
+
+	float area();
+
+	float visibleArea();
+
+	bool isTwoSided();
+
+};
+
+#endif //!H_SPHERELIGHT
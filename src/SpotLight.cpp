@@ -0,0 +1,31 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "SpotLight.h"
+
+SpotLight::SpotLight(glm::vec3 pos, glm::vec3 dir, float innerAngle, float outerAngle) :
+	PointLight(pos), direction(glm::normalize(dir))
+{
+	cosInner = cos(glm::radians(innerAngle));
+	cosOuter = cos(glm::radians(outerAngle));
+}
+
+glm::vec3 SpotLight::illuminate(glm::vec3 p, glm::vec3& lightVec, float& lightDist)
+{
+	glm::vec3 radiance = PointLight::illuminate(p, lightVec, lightDist);
+	float cosAngle = glm::dot(-lightVec, direction);
+	return glm::smoothstep(cosOuter, cosInner, cosAngle) * radiance;
+}
+
+bool SpotLight::emissionBounds(glm::vec3& pos, glm::vec3& axis, float& thetaO, float& thetaE)
+{
+	pos = position;
+	axis = direction;
+	thetaO = 0;
+	thetaE = acos(cosOuter);
+	return true;
+}
@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#ifndef H_SPOTLIGHT
+#define H_SPOTLIGHT
+#include <glm/glm.hpp>
+#include "PointLight.h"
+
+/**
+ * Defines a point light at 'position' restricted to a cone around 'direction'.
+ * The light is at full strength inside 'innerAngle' and fades out to zero
+ * at 'outerAngle' (both half angles in degrees).
+ */
+class SpotLight : public PointLight
+{
+
+private:
+	glm::vec3 direction = glm::vec3(0, -1, 0);
+	float cosInner = 0.9;
+	float cosOuter = 0.8;
+
+public:
+	SpotLight() {};
+
+	SpotLight(glm::vec3 pos, glm::vec3 dir, float innerAngle, float outerAngle);
+
+	glm::vec3 illuminate(glm::vec3 p, glm::vec3& lightVec, float& lightDist);
+
+	bool emissionBounds(glm::vec3& pos, glm::vec3& axis, float& thetaO, float& thetaE);
+
+};
+
+#endif //!H_SPOTLIGHT
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "TemporalAccumulator.h"
+#include "Parallel.h"
+#include <math.h>
+#include <algorithm>
+#include <atomic>
+
+const float DEPTH_TOLERANCE = 0.01; // Relative depth difference of history that is still the same surface
+const float MIN_WEIGHT = 0.01; // Bilinear weight of the valid history taps below which it is discarded
+
+
+/**
+* Reprojects the history into 'frame' and blends it with the new colour. Rows are
+* shared between threads.
+*/
+void TemporalAccumulator::accumulate(FrameBuffer& frame)
+{
+	int n = camera.getNumDiv();
+	if (!frame.has(CHANNELS)) return;
+	if (historyLength.size() != n * n) reset();
+	bool motion = frame.has(AOV_MOTION);
+	std::vector<glm::vec3> color(n * n);
+	std::vector<int> length(n * n);
+	std::atomic<int> reused(0);
+
+	parallelFor(n, [&](int j) {
+		int rowReused = 0;
+		for (int i = 0; i < n; i++)
+		{
+			int p = j * n + i;
+			color[p] = frame.color[p];
+			length[p] = 1;
+			int id = frame.objectId[p];
+			glm::vec2 cell;
+			if (id == -1 || !previous.project(frame.position[p], cell)) continue;
+			if (motion) frame.motion[p] = glm::vec2(i + 0.5f, j + 0.5f) - cell;
+
+			// Bilinear fetch of the history taps that show the same surface
+			float dist = glm::length(frame.position[p] - previous.getEye());
+			float x = cell.x - 0.5f, y = cell.y - 0.5f;
+			int x0 = (int)floorf(x), y0 = (int)floorf(y);
+			float fx = x - x0, fy = y - y0;
+			glm::vec3 sum(0);
+			float weightSum = 0, lengthSum = 0;
+			for (int k = 0; k < 4; k++)
+			{
+				int tx = x0 + (k & 1), ty = y0 + (k >> 1);
+				if (tx < 0 || tx >= n || ty < 0 || ty >= n) continue;
+				int q = ty * n + tx;
+				if (historyLength[q] == 0 || historyId[q] != id) continue;
+				if (fabsf(historyDepth[q] - dist) > DEPTH_TOLERANCE * dist) continue;
+				float w = ((k & 1) ? fx : 1 - fx) * ((k >> 1) ? fy : 1 - fy);
+				sum += w * history[q];
+				lengthSum += w * historyLength[q];
+				weightSum += w;
+			}
+			if (weightSum < MIN_WEIGHT) continue; // Disoccluded
+
+			length[p] = std::min((int)(lengthSum / weightSum + 0.5f) + 1, maxHistory);
+			glm::vec3 prev = sum / weightSum;
+			color[p] = prev + (frame.color[p] - prev) / (float)length[p];
+			rowReused++;
+		}
+		reused += rowReused;
+	});
+
+	history = color;
+	historyDepth = frame.depth;
+	historyId = frame.objectId;
+	historyLength.swap(length);
+	previous = camera;
+	frame.color.swap(color);
+	reuse = (float)reused / (n * n);
+}
+
+/**
+* Discards the history, e.g. after a camera cut.
+*/
+void TemporalAccumulator::reset()
+{
+	int n = camera.getNumDiv();
+	history.assign(n * n, glm::vec3(0));
+	historyDepth.assign(n * n, 0.0f);
+	historyId.assign(n * n, -1);
+	historyLength.assign(n * n, 0);
+	reuse = 0;
+}
+
+void TemporalAccumulator::setMaxHistory(int frames)
+{
+	maxHistory = std::max(1, frames);
+}
+
+float TemporalAccumulator::getReuse()
+{
+	return reuse;
+}
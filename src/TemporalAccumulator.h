@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#ifndef H_TEMPORAL
+#define H_TEMPORAL
+#include <glm/glm.hpp>
+#include <vector>
+#include "Camera.h"
+#include "FrameBuffer.h"
+
+/**
+ * Accumulates the colour of successive frames of a camera animation. The primary
+ * hit of every pixel (position AOV) is projected into the previous frame's camera,
+ * which gives its motion vector, and the accumulated history is fetched there with
+ * bilinear filtering. History samples of another object, or at a depth that does
+ * not match, are rejected (disocclusion); a pixel without valid history starts
+ * again from the current frame. Otherwise the current frame is blended in with
+ * weight 1/n, n counting the frames accumulated so far (at most 'maxHistory', after
+ * which older frames fade out exponentially).
+ */
+class TemporalAccumulator
+{
+
+private:
+	static const int DEFAULT_HISTORY = 32;
+
+	Camera& camera;
+	Camera previous; // Camera of the history
+	int maxHistory = DEFAULT_HISTORY;
+	std::vector<glm::vec3> history; // Accumulated colour
+	std::vector<float> historyDepth;
+	std::vector<int> historyId;
+	std::vector<int> historyLength; // Frames accumulated per pixel, 0 = no history
+	float reuse = 0; // Fraction of the pixels of the last frame that reused history
+
+public:
+	static const unsigned int CHANNELS = AOV_DEPTH | AOV_OBJECT_ID | AOV_POSITION;
+
+	TemporalAccumulator(Camera& c) : camera(c) {}
+
+	/**
+	 * Blends the history into the colour of 'frame' (which must include CHANNELS)
+	 * and keeps the result as the history of the next frame. Fills the motion
+	 * vector AOV if 'frame' has one.
+	 */
+	void accumulate(FrameBuffer& frame);
+
+	void reset();
+
+	void setMaxHistory(int frames);
+
+	float getReuse();
+
+};
+
+#endif //!H_TEMPORAL
@@ -8,13 +8,66 @@
 //=====================================================================
 
 #include "TextureBMP.h"
+#include "TextureCache.h"
+#include <cstring>
+#include <math.h>
+#include <algorithm>
+#if defined(_WIN32)
+#include <vector>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
-TextureBMP::TextureBMP(const char* filename)
+namespace
+{
+	// Maps the whole file read-only. Returns an empty pointer on failure.
+	shared_ptr<const unsigned char> mapFile(const char* filename, size_t& length)
+	{
+#if defined(_WIN32)
+		ifstream file(filename, ios::in | ios::binary | ios::ate);
+		if (!file) return nullptr;
+		length = (size_t)file.tellg();
+		unsigned char* data = new unsigned char[length];
+		file.seekg(0);
+		file.read((char*)data, length);
+		return shared_ptr<const unsigned char>(data, default_delete<const unsigned char[]>());
+#else
+		int fd = open(filename, O_RDONLY);
+		if (fd < 0) return nullptr;
+		struct stat info;
+		if (fstat(fd, &info) != 0 || info.st_size == 0) {
+			close(fd);
+			return nullptr;
+		}
+		length = info.st_size;
+		void* data = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd); // The mapping keeps the file open
+		if (data == MAP_FAILED) return nullptr;
+		madvise(data, length, MADV_RANDOM); // Texture lookups do not run along the file
+		return shared_ptr<const unsigned char>((const unsigned char*)data,
+			[length](const unsigned char* p) { munmap((void*)p, length); });
+#endif
+	}
+
+	template <typename T>
+	T readValue(const unsigned char* p)
+	{
+		T value;
+		memcpy(&value, p, sizeof(T)); // The header fields are not aligned
+		return value;
+	}
+}
+
+TextureBMP::TextureBMP(const char* filename, Layout layout, TextureCache* cache) : layout(layout), cache(layout == STREAMED ? cache : nullptr)
 {
 	imageWid = 0;
 	imageHgt = 0;
+	imageChnls = 0;
     if (loadBMPImage(filename)) {
-		cout << "Image " << filename << "  loaded successfully." << endl;
+		clog << "Image " << filename << "  loaded successfully." << endl;
 		//cout << "Width = " << imageWid << "  Height = " << imageHgt <<
 		//	"  Channels = " << imageChnls << endl;
     } else {
@@ -31,59 +84,243 @@ glm::vec3 TextureBMP::getColorAt(float s, float t)
     int i = (int) (s * imageWid);  //pixel coordinates
     int j = (int) (t * imageHgt);
 	if(i < 0 || i > imageWid-1 || j < 0 || j > imageHgt-1) return glm::vec3(0);
-    int index = ((j * imageWid) + i) * imageChnls;
-
-    int r = imageData[index];
-    int g = imageData[index + 1];
-    int b = imageData[index + 2];
-
-	if(r < 0) r += 255;   //Unsigned byte values
-	if(g < 0) g += 255;
-	if(b < 0) b += 255;
- 
-    float rn = (float)r / 255.0;  //Normalized colour values
-    float gn = (float)g / 255.0;
-    float bn = (float)b / 255.0;
-    return glm::vec3(rn, gn, bn);
+    return fetch(0, i, j) / 255.0f;  //Normalized colour values
+}
+
+/**
+ * Return color at texture coord (s, t), filtered over the footprint spanned by the
+ * texture coordinate offsets 'dx' and 'dy' (e.g. to the neighbouring pixels)
+ */
+glm::vec3 TextureBMP::getColorAt(float s, float t, glm::vec2 dx, glm::vec2 dy)
+{
+	if(imageWid == 0 || imageHgt == 0) return glm::vec3(0);
+	if(s < 0 || s >= 1 || t < 0 || t >= 1) return glm::vec3(0);
+	glm::vec2 size(imageWid, imageHgt);
+	float width = max(glm::length(dx * size), glm::length(dy * size));  //Footprint in texels
+	float lod = width > 1 ? log2f(width) : 0;
+	lod = min(lod, (float)(levels.size() - 1));
+	int l0 = (int)lod;
+	float f = lod - l0;
+	glm::vec3 color = bilinear(l0, s, t);
+	if(f > 0) color = (1 - f) * color + f * bilinear(l0 + 1, s, t);
+	return color;
+}
+
+int TextureBMP::getWidth()
+{
+	return imageWid;
+}
+
+int TextureBMP::getHeight()
+{
+	return imageHgt;
+}
+
+/**
+ * Bilinear interpolation of the texels of a mip level, clamped at its edges
+ */
+glm::vec3 TextureBMP::bilinear(int l, float s, float t)
+{
+	const MipLevel& level = levels[l];
+	float x = s * level.wid - 0.5f, y = t * level.hgt - 0.5f;
+	int x0 = (int)floorf(x), y0 = (int)floorf(y);
+	float fx = x - x0, fy = y - y0;
+	int xs[2] = { max(x0, 0), min(x0 + 1, level.wid - 1) };
+	int ys[2] = { max(y0, 0), min(y0 + 1, level.hgt - 1) };
+	glm::vec3 texels[4];
+	if(cache != nullptr)
+	{
+		unsigned char bgrx[4][4];
+		cache->texels(cacheId, l, xs, ys, bgrx);  //Pins the tiles once for all four texels
+		for(int k = 0; k < 4; k++) texels[k] = glm::vec3(bgrx[k][2], bgrx[k][1], bgrx[k][0]);
+	}
+	else
+	{
+		for(int k = 0; k < 4; k++) texels[k] = fetch(l, xs[k & 1], ys[k >> 1]);
+	}
+	glm::vec3 color(0);
+	for(int k = 0; k < 4; k++)
+	{
+		float w = ((k & 1) ? fx : 1 - fx) * ((k >> 1) ? fy : 1 - fy);
+		color += w * texels[k];
+	}
+	return color / 255.0f;
+}
+
+/**
+ * RGB values (0 to 255) of texel (x, y) of a mip level
+ */
+glm::vec3 TextureBMP::fetch(int level, int x, int y)
+{
+	if(cache != nullptr)
+	{
+		unsigned char bgrx[4];
+		cache->texel(cacheId, level, x, y, bgrx);
+		return glm::vec3(bgrx[2], bgrx[1], bgrx[0]);
+	}
+	const unsigned char* texel = levels[level].pixels + texelOffset(levels[level], x, y);
+	return glm::vec3(texel[2], texel[1], texel[0]);
+}
+
+/**
+ * Byte offset of texel (x, y) from the start of a level
+ */
+long TextureBMP::texelOffset(const MipLevel& level, int x, int y)
+{
+	if(level.tilesX == 0) return y * level.rowStride + x * level.channels;
+	const int mask = (1 << TILE_SHIFT) - 1;
+	long tile = (long)(y >> TILE_SHIFT) * level.tilesX + (x >> TILE_SHIFT);
+	return (((tile << TILE_SHIFT) + (y & mask)) << TILE_SHIFT | (x & mask)) * level.channels;
+}
+
+/**
+ * Builds levels 1 and above of the mip chain, down to a single texel, by averaging
+ * 2x2 blocks of the level below (edge texels are repeated for odd sizes). With the
+ * tiled layout, level 0 is first copied out of the mapping into tiles.
+ */
+void TextureBMP::buildMipmaps()
+{
+	bool tiled = layout == TILED;
+	int tileTexels = 1 << TILE_SHIFT;
+	auto levelSize = [&](int w, int h) {
+		if(!tiled) return (size_t)w * h * 3;
+		size_t tilesX = (w + tileTexels - 1) >> TILE_SHIFT, tilesY = (h + tileTexels - 1) >> TILE_SHIFT;
+		return (tilesX * tilesY << (2 * TILE_SHIFT)) * 4;
+	};
+	size_t total = tiled ? levelSize(imageWid, imageHgt) : 0;
+	for(int w = imageWid, h = imageHgt; w > 1 || h > 1; )
+	{
+		w = max(w / 2, 1);
+		h = max(h / 2, 1);
+		total += levelSize(w, h);
+	}
+	texelData = make_shared<vector<unsigned char>>(total);
+	unsigned char* out = texelData->data();
+	auto newLevel = [&](int w, int h) {
+		MipLevel level = { out, (long)w * 3, tiled ? 4 : 3, w, h, tiled ? (w + tileTexels - 1) >> TILE_SHIFT : 0 };
+		out += levelSize(w, h);
+		return level;
+	};
+
+	if(tiled) {
+		MipLevel src = levels[0];
+		MipLevel dst = newLevel(src.wid, src.hgt);
+		unsigned char* texels = (unsigned char*)dst.pixels;
+		for(int j = 0; j < src.hgt; j++)
+		{
+			for(int i = 0; i < src.wid; i++)
+			{
+				memcpy(texels + texelOffset(dst, i, j), src.pixels + texelOffset(src, i, j), 3);
+			}
+		}
+		levels[0] = dst;
+		fileData.reset(); //No longer sampled
+	}
+
+	while(levels.back().wid > 1 || levels.back().hgt > 1)
+	{
+		MipLevel src = levels.back();
+		MipLevel dst = newLevel(max(src.wid / 2, 1), max(src.hgt / 2, 1));
+		unsigned char* texels = (unsigned char*)dst.pixels;
+		for(int j = 0; j < dst.hgt; j++)
+		{
+			int j0 = min(2 * j, src.hgt - 1), j1 = min(2 * j + 1, src.hgt - 1);
+			for(int i = 0; i < dst.wid; i++)
+			{
+				int i0 = min(2 * i, src.wid - 1), i1 = min(2 * i + 1, src.wid - 1);
+				const unsigned char* t00 = src.pixels + texelOffset(src, i0, j0);
+				const unsigned char* t10 = src.pixels + texelOffset(src, i1, j0);
+				const unsigned char* t01 = src.pixels + texelOffset(src, i0, j1);
+				const unsigned char* t11 = src.pixels + texelOffset(src, i1, j1);
+				unsigned char* texel = texels + texelOffset(dst, i, j);
+				for(int c = 0; c < 3; c++)
+				{
+					texel[c] = (t00[c] + t10[c] + t01[c] + t11[c] + 2) / 4;
+				}
+			}
+		}
+		levels.push_back(dst);
+	}
 }
 
 bool TextureBMP::loadBMPImage(const char* filename)
 {
-    char header1[18], header2[24];
-    short int planes, bpp;
-    int wid, hgt;
-    int nbytes, size, indx, temp;
-    ifstream file( filename, ios::in | ios::binary);
-    if(!file)
+    size_t length = 0;
+    shared_ptr<const unsigned char> data = mapFile(filename, length);
+    if(!data)
     {
-        cout << "*** Error opening image file: " << filename << endl;
+        cerr << "*** Error opening image file: " << filename << endl;
         return false;
     }
-    file.read (header1, 18);        //Initial part of header
-    file.read ((char*)&wid, 4);     //Width
-    file.read ((char*)&hgt, 4);     //Height
-    file.read ((char*)&planes, 2);  //Planes
-    file.read ((char*)&bpp, 2);     //Bits per pixel
-    file.read (header2, 24);        //Remaining part of header
-
-    nbytes = bpp / 8;           //No. of bytes per pixels
-    size = wid * hgt * nbytes;  //Total number of bytes to be read
-    imageData = new char[size];
-    file.read(imageData, size);
-    if(nbytes > 2)   //swap R and B
+    const unsigned char* file = data.get();
+    if(length < 54 || file[0] != 'B' || file[1] != 'M')
     {
-        for(int i = 0; i < wid*hgt;  i++)
-        {
-            indx = i*nbytes;
-            temp = imageData[indx];
-            imageData[indx] = imageData[indx+2];
-            imageData[indx+2] = temp;
-        }
+        cerr << "*** Not a BMP file: " << filename << endl;
+        return false;
+    }
+    unsigned int offset = readValue<unsigned int>(file + 10);   //Start of the pixel array
+    int wid = readValue<int>(file + 18);
+    int hgt = readValue<int>(file + 22);    //Negative for top-down images
+    short int bpp = readValue<short int>(file + 28);
+    unsigned int compression = readValue<unsigned int>(file + 30);
+
+    int nbytes = bpp / 8;   //No. of bytes per pixels
+    long stride = ((long)wid * nbytes + 3) / 4 * 4;     //Rows are padded to 4 bytes
+    int rows = hgt < 0 ? -hgt : hgt;
+    if((nbytes != 3 && nbytes != 4) || (compression != 0 && compression != 3) || wid <= 0 || rows == 0
+        || offset > length || (length - offset) / stride < (size_t)rows)
+    {
+        cerr << "*** Unsupported or truncated BMP file: " << filename << endl;
+        return false;
     }
 
+    fileData = data;
+    MipLevel base = { file + offset, stride, nbytes, wid, rows, 0 };
+    if(hgt < 0)     //Top-down: start at the last row and step backwards
+    {
+        base.pixels += (rows - 1) * stride;
+        base.rowStride = -stride;
+    }
+    levels.assign(1, base);
     imageWid = wid;
-    imageHgt = hgt;
+    imageHgt = rows;
     imageChnls = nbytes;
+    if(layout == STREAMED && cache == nullptr) layout = ROW_MAJOR;
+    if(layout != STREAMED)
+    {
+        buildMipmaps();
+        return true;
+    }
+
+    //Streamed: the cache decodes the tiles of level 0 from the mapping and builds the others
+    cacheId = cache->addTexture(wid, rows, [data, base](int tx, int ty, unsigned char* texels) {
+        const int size = TextureCache::TILE_SIZE;
+        for(int j = 0; j < size && ty * size + j < base.hgt; j++)
+        {
+            const unsigned char* row = base.pixels + (long)(ty * size + j) * base.rowStride;
+            for(int i = 0; i < size && tx * size + i < base.wid; i++)
+            {
+                unsigned char* texel = texels + (j * size + i) * 4;
+                memcpy(texel, row + (long)(tx * size + i) * base.channels, 3);
+                texel[3] = 0;
+            }
+        }
+    });
+    if(cacheId < 0)
+    {
+        cerr << "*** Texture cache full: " << filename << endl;
+        cache = nullptr;
+        return false;
+    }
+    TextureCache* owner = cache;
+    int id = cacheId;
+    cacheEntry = shared_ptr<void>(nullptr, [owner, id](void*) { owner->removeTexture(id); });
+    for(int w = wid, h = rows; w > 1 || h > 1; )
+    {
+        w = max(w / 2, 1);
+        h = max(h / 2, 1);
+        levels.push_back({ nullptr, 0, 4, w, h, 0 });  //Sizes only
+    }
 
     return true;
 }
@@ -12,20 +12,69 @@
 
 #include <iostream>
 #include <fstream>
+#include <memory>
+#include <vector>
 #include <glm/glm.hpp>
 using namespace std;
 
+class TextureCache;
+
+/**
+ * The file is memory-mapped. With the ROW_MAJOR layout (the default) its pixel array
+ * is sampled in place: texels are read straight from the mapping, in the file's BGR
+ * order and padded rows, so loading costs no copy. With the TILED layout the texels
+ * are reordered at load time into 8x8 tiles of 4 byte texels, so that the 2D-local
+ * lookups of neighbouring rays, and the 2x2 texels of a bilinear lookup, fall into
+ * the same few cache lines instead of rows thousands of bytes apart. The tiled copy
+ * costs a full decode and is a third larger than the file's pixels (the mapping is
+ * then released); it only pays off for textures much larger than the CPU caches
+ * that are sampled across their rows, e.g. rotated, and is slower for small ones.
+ * With the STREAMED layout nothing is decoded at load time: texels are served by a
+ * TextureCache, which reads 64x64 tiles out of the mapping when first sampled and
+ * keeps them within its memory budget. Only the pages of the file that hold sampled
+ * tiles are ever read, so texture sets larger than memory can be rendered.
+ * Copies of a texture share its data, which is freed with the last of them.
+ *
+ * A mip chain of box-filtered levels, each half the size of the one before, is built
+ * at load time next to the mapping (a third of its size), or tile by tile by the
+ * cache. Lookups with a footprint filter trilinearly between the two levels whose
+ * texel size matches it.
+ */
 class TextureBMP
 {
     private:
-        int imageWid, imageHgt, imageChnls;  //Width, height, number of channels
-        char* imageData;
+        int imageWid, imageHgt, imageChnls;  //Width, height, number of channels (bytes per pixel)
+    public:
+        enum Layout { ROW_MAJOR, TILED, STREAMED };
+    private:
+        static const int TILE_SHIFT = 3; //Tiles of 8x8 texels
+        struct MipLevel
+        {
+            const unsigned char* pixels; //Bottom row, or first tile, of BGR texels
+            long rowStride; //Row-major: bytes from one row to the one above it, including padding
+            int channels; //Bytes per texel
+            int wid, hgt;
+            int tilesX; //Tiled: tiles per row of tiles, 0 for row-major levels
+        };
+        Layout layout = ROW_MAJOR;
+        shared_ptr<const unsigned char> fileData; //The mapped file, while sampled in place
+        shared_ptr<vector<unsigned char>> texelData; //Levels built at load time
+        vector<MipLevel> levels;
+        TextureCache* cache = nullptr; //Streamed: source of the texels
+        int cacheId = -1;
+        shared_ptr<void> cacheEntry; //Streamed: removes the texture from the cache with the last copy
         bool loadBMPImage(const char* string);
+        void buildMipmaps();
+        static long texelOffset(const MipLevel& level, int x, int y);
+        glm::vec3 fetch(int level, int x, int y);
+        glm::vec3 bilinear(int level, float s, float t);
     public:
 		TextureBMP(): imageWid(0), imageHgt(0), imageChnls(0) {}
-        TextureBMP(const char* string);
+        TextureBMP(const char* string, Layout layout = ROW_MAJOR, TextureCache* cache = nullptr);
         glm::vec3 getColorAt(float s, float t);
+        glm::vec3 getColorAt(float s, float t, glm::vec2 dx, glm::vec2 dy);
+        int getWidth();
+        int getHeight();
 };
 
 #endif
-
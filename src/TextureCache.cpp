@@ -0,0 +1,384 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "TextureCache.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+const size_t MIN_PAGES = 64; // Enough for a miss to pin a tile and its children at every level
+
+namespace
+{
+	// Lookups counted by the calling thread, added to the cache's total when the
+	// thread exits (render threads live for one parallelFor task) or the total is read
+	struct LookupTally
+	{
+		std::atomic<long long>* total = nullptr;
+		long long count = 0;
+
+		void flush()
+		{
+			if (total != nullptr && count != 0) *total += count;
+			count = 0;
+		}
+
+		~LookupTally() { flush(); }
+	};
+	thread_local LookupTally lookupTally;
+}
+
+
+TextureCache::~TextureCache()
+{
+	if (lookupTally.total == &lookups) lookupTally.total = nullptr;
+	for (std::atomic<Texture*>& texture : textures) delete texture.load();
+}
+
+// Key of a tile: 10 bits of texture id, 6 bits of level and 48 bits of tile index.
+uint64_t TextureCache::makeKey(int texture, int level, int tile)
+{
+	return (uint64_t)texture << 54 | (uint64_t)level << 48 | (uint64_t)tile;
+}
+
+std::atomic<TextureCache::Page*>& TextureCache::slot(uint64_t key)
+{
+	Texture* tex = textures[key >> 54].load();
+	return tex->levels[(key >> 48) & 63].slots[key & ((1ull << 48) - 1)];
+}
+
+/**
+* Returns the page holding a tile, pinned, or nullptr if the tile is not resident.
+* Takes no lock.
+*/
+TextureCache::Page* TextureCache::pin(int texture, int level, int tx, int ty)
+{
+	Level& lv = textures[texture].load(std::memory_order_acquire)->levels[level];
+	int tile = ty * lv.tilesX + tx;
+	Page* page = lv.slots[tile].load(std::memory_order_acquire);
+	if (page == nullptr) return nullptr;
+	page->pins.fetch_add(1);
+	if (page->key.load() != makeKey(texture, level, tile)) { // Evicted since the slot was read
+		unpin(page);
+		return nullptr;
+	}
+	if (page->credit.load(std::memory_order_relaxed) <= level) page->credit.store(level + 1, std::memory_order_relaxed);
+	return page;
+}
+
+void TextureCache::unpin(Page* page)
+{
+	int pins = page->pins.fetch_sub(1);
+	assert(pins > 0); // A lost pin lets the sweep evict a page that is being read
+	(void)pins;
+}
+
+/**
+* Loads a tile that was not resident and returns its page, pinned.
+*/
+TextureCache::Page* TextureCache::load(int texture, int level, int tx, int ty)
+{
+	std::lock_guard<std::recursive_mutex> guard(missLock);
+	Page* page = pin(texture, level, tx, ty); // Another thread may have loaded it meanwhile
+	if (page != nullptr) return page;
+
+	Texture* tex = textures[texture].load();
+	Level& lv = tex->levels[level];
+	int tile = ty * lv.tilesX + tx;
+	page = freePage();
+	// Pinned so the loads of the tiles below it do not evict it. Added to, not stored:
+	// lookups that read the slot before the page was evicted may still hold pins on it
+	page->pins.fetch_add(1);
+	if (level == 0) tex->loader(tx, ty, page->texels.get());
+	else downsample(texture, level, tx, ty, page->texels.get());
+	page->credit.store(level + 1);
+	page->key.store(makeKey(texture, level, tile));
+	lv.slots[tile].store(page, std::memory_order_release);
+	if (resident > capacity()) trim(); // Pages added while every page was pinned
+	return page;
+}
+
+/**
+* Takes back the first page the CLOCK sweep finds unpinned and out of credit, and
+* returns it with the key BUSY, or nullptr if every page is pinned. Called with the
+* miss lock held.
+*/
+TextureCache::Page* TextureCache::evict()
+{
+	bool spared = true; // Credit taken in the last sweep: the next one may find a page
+	while (spared)
+	{
+		spared = false;
+		for (size_t step = 0; step < pages.size(); step++)
+		{
+			Page* page = pages[hand].get();
+			hand = (hand + 1) % pages.size();
+			if (!page->texels) continue; // Released
+			uint64_t key = page->key.load();
+			if (key == BUSY || page->pins.load() > 0) continue;
+			if (key != EMPTY && page->credit.load() > 0) { // Another chance
+				page->credit.fetch_sub(1);
+				spared = true;
+				continue;
+			}
+			page->key.store(BUSY);
+			if (page->pins.load() > 0) { // Pinned by a lookup since the check above
+				page->key.store(key);
+				continue;
+			}
+			if (key != EMPTY) {
+				slot(key).store(nullptr);
+				evictions++;
+			}
+			return page;
+		}
+	}
+	return nullptr;
+}
+
+/**
+* Returns a page that holds no tile, with the key BUSY: a new one while the budget
+* allows (or if every page is pinned), else one taken back by the CLOCK sweep.
+* Called with the miss lock held.
+*/
+TextureCache::Page* TextureCache::freePage()
+{
+	if (resident >= capacity()) {
+		Page* page = evict();
+		if (page != nullptr) return page;
+	}
+
+	Page* page;
+	if (!released.empty()) {
+		page = released.back();
+		released.pop_back();
+	}
+	else {
+		pages.emplace_back(new Page());
+		page = pages.back().get();
+	}
+	page->texels.reset(new unsigned char[TILE_BYTES]);
+	page->key.store(BUSY);
+	resident++;
+	return page;
+}
+
+/**
+* Frees the texels of pages taken back by the CLOCK sweep until the resident pages
+* fit in the budget, or every page left is pinned. The page itself is kept (without
+* texels) for reuse, as a lookup that read its slot before the eviction may still
+* pin it. Called with the miss lock held.
+*/
+void TextureCache::trim()
+{
+	while (resident > capacity())
+	{
+		Page* page = evict();
+		if (page == nullptr) return;
+		page->texels.reset();
+		page->key.store(EMPTY);
+		released.push_back(page);
+		resident--;
+	}
+}
+
+size_t TextureCache::capacity()
+{
+	return std::max(budget / TILE_BYTES, MIN_PAGES);
+}
+
+/**
+* Fills 'texels' with tile (tx, ty) of a coarse mip level by averaging 2x2 blocks of
+* the level below (edge texels are repeated for odd sizes).
+*/
+void TextureCache::downsample(int texture, int level, int tx, int ty, unsigned char* texels)
+{
+	Texture* tex = textures[texture].load();
+	const Level& dst = tex->levels[level];
+	const Level& src = tex->levels[level - 1];
+	Page* children[2][2] = {};
+	for (int k = 0; k < 4; k++)
+	{
+		int cx = 2 * tx + (k & 1), cy = 2 * ty + (k >> 1);
+		if (cx >= src.tilesX || cy >= src.tilesY) continue;
+		Page* child = pin(texture, level - 1, cx, cy);
+		children[k >> 1][k & 1] = child != nullptr ? child : load(texture, level - 1, cx, cy);
+	}
+	auto srcTexel = [&](int x, int y) {
+		Page* child = children[(y >> TILE_SHIFT) - 2 * ty][(x >> TILE_SHIFT) - 2 * tx];
+		return child->texels.get() + (((y & (TILE_SIZE - 1)) << TILE_SHIFT) + (x & (TILE_SIZE - 1))) * 4;
+	};
+
+	int x0 = tx << TILE_SHIFT, y0 = ty << TILE_SHIFT;
+	for (int j = 0; j < TILE_SIZE && y0 + j < dst.hgt; j++)
+	{
+		int y = y0 + j;
+		int sy0 = std::min(2 * y, src.hgt - 1), sy1 = std::min(2 * y + 1, src.hgt - 1);
+		for (int i = 0; i < TILE_SIZE && x0 + i < dst.wid; i++)
+		{
+			int x = x0 + i;
+			int sx0 = std::min(2 * x, src.wid - 1), sx1 = std::min(2 * x + 1, src.wid - 1);
+			const unsigned char* t00 = srcTexel(sx0, sy0);
+			const unsigned char* t10 = srcTexel(sx1, sy0);
+			const unsigned char* t01 = srcTexel(sx0, sy1);
+			const unsigned char* t11 = srcTexel(sx1, sy1);
+			unsigned char* texel = texels + ((j << TILE_SHIFT) + i) * 4;
+			for (int c = 0; c < 3; c++)
+			{
+				texel[c] = (t00[c] + t10[c] + t01[c] + t11[c] + 2) / 4;
+			}
+			texel[3] = 0;
+		}
+	}
+
+	for (Page* child : { children[0][0], children[0][1], children[1][0], children[1][1] })
+	{
+		if (child != nullptr) unpin(child);
+	}
+}
+
+int TextureCache::addTexture(int wid, int hgt, const TileLoader& loader)
+{
+	std::lock_guard<std::recursive_mutex> guard(missLock);
+	for (int id = 0; id < MAX_TEXTURES; id++)
+	{
+		if (textures[id].load() != nullptr) continue;
+		Texture* tex = new Texture();
+		tex->loader = loader;
+		for (int w = wid, h = hgt; ; w = std::max(w / 2, 1), h = std::max(h / 2, 1))
+		{
+			Level lv;
+			lv.wid = w;
+			lv.hgt = h;
+			lv.tilesX = (w + TILE_SIZE - 1) >> TILE_SHIFT;
+			lv.tilesY = (h + TILE_SIZE - 1) >> TILE_SHIFT;
+			lv.slots.reset(new std::atomic<Page*>[(size_t)lv.tilesX * lv.tilesY]());
+			tex->levels.push_back(std::move(lv));
+			if (w == 1 && h == 1) break;
+		}
+		textures[id].store(tex, std::memory_order_release);
+		return id;
+	}
+	return -1;
+}
+
+void TextureCache::removeTexture(int texture)
+{
+	std::lock_guard<std::recursive_mutex> guard(missLock);
+	Texture* tex = textures[texture].load();
+	if (tex == nullptr) return;
+	for (std::unique_ptr<Page>& page : pages)
+	{
+		uint64_t key = page->key.load();
+		if (key != EMPTY && key != BUSY && (int)(key >> 54) == texture) page->key.store(EMPTY);
+	}
+	textures[texture].store(nullptr);
+	delete tex;
+}
+
+/**
+* Counts a lookup and returns the page of a tile, pinned, loading it if needed.
+* 'missed' is set if the tile was not resident.
+*/
+TextureCache::Page* TextureCache::acquire(int texture, int level, int tx, int ty, bool& missed)
+{
+	Page* page = pin(texture, level, tx, ty);
+	if (page != nullptr) return page;
+	missed = true;
+	return load(texture, level, tx, ty);
+}
+
+// Counts a lookup, and a miss if one of its tiles was not resident.
+void TextureCache::count(bool missed)
+{
+	if (lookupTally.total != &lookups) {
+		lookupTally.flush();
+		lookupTally.total = &lookups;
+	}
+	lookupTally.count++;
+	if (missed) misses++;
+}
+
+const unsigned char* TextureCache::texelOf(const Page* page, int x, int y)
+{
+	return page->texels.get() + (((y & (TILE_SIZE - 1)) << TILE_SHIFT) + (x & (TILE_SIZE - 1))) * 4;
+}
+
+void TextureCache::texel(int texture, int level, int x, int y, unsigned char* bgrx)
+{
+	bool missed = false;
+	Page* page = acquire(texture, level, x >> TILE_SHIFT, y >> TILE_SHIFT, missed);
+	memcpy(bgrx, texelOf(page, x, y), 4);
+	unpin(page);
+	count(missed);
+}
+
+void TextureCache::texels(int texture, int level, const int xs[2], const int ys[2], unsigned char bgrx[4][4])
+{
+	bool missed = false;
+	Page* pages[4];
+	for (int k = 0; k < 4; k++)
+	{
+		int tx = xs[k & 1] >> TILE_SHIFT, ty = ys[k >> 1] >> TILE_SHIFT;
+		int same = -1; // Earlier texel in the same tile, whose page is already pinned
+		for (int m = 0; m < k && same < 0; m++)
+		{
+			if (xs[m & 1] >> TILE_SHIFT == tx && ys[m >> 1] >> TILE_SHIFT == ty) same = m;
+		}
+		pages[k] = same >= 0 ? pages[same] : acquire(texture, level, tx, ty, missed);
+		memcpy(bgrx[k], texelOf(pages[k], xs[k & 1], ys[k >> 1]), 4);
+	}
+	for (int k = 0; k < 4; k++)
+	{
+		bool first = true;
+		for (int m = 0; m < k; m++) first = first && pages[m] != pages[k];
+		if (first) unpin(pages[k]);
+	}
+	count(missed);
+}
+
+void TextureCache::setBudget(size_t budgetBytes)
+{
+	std::lock_guard<std::recursive_mutex> guard(missLock);
+	budget = budgetBytes;
+	trim();
+}
+
+size_t TextureCache::getBudget()
+{
+	return budget;
+}
+
+size_t TextureCache::getResidentBytes()
+{
+	std::lock_guard<std::recursive_mutex> guard(missLock);
+	return resident * (size_t)TILE_BYTES;
+}
+
+long long TextureCache::getHits()
+{
+	if (lookupTally.total == &lookups) lookupTally.flush();
+	return lookups - misses;
+}
+
+long long TextureCache::getMisses()
+{
+	return misses;
+}
+
+long long TextureCache::getEvictions()
+{
+	return evictions;
+}
+
+void TextureCache::resetStatistics()
+{
+	if (lookupTally.total == &lookups) lookupTally.count = 0;
+	lookups = 0;
+	misses = 0;
+	evictions = 0;
+}
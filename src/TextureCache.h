@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#ifndef H_TEXCACHE
+#define H_TEXCACHE
+#include <glm/glm.hpp>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <functional>
+#include <cstdint>
+
+/**
+ * Keeps the texels of streamed textures in fixed-size tiles that are loaded on
+ * demand, within a memory budget. Only the tiles of mip level 0 are read from the
+ * texture's source; those of the coarser levels are filtered from the four tiles
+ * below them when first needed, so nothing is decoded up front.
+ *
+ * Lookups of resident tiles take no lock: every tile of a texture has a slot holding
+ * the page it occupies, and a lookup pins the page (an atomic counter) for as long
+ * as it reads it. Misses load the tile under a single lock. When the budget is used
+ * up, a page is taken back with the CLOCK approximation of LRU: a hit gives the page
+ * credit, and the eviction sweep spares pages with credit left, taking one from them.
+ * A tile of level L is worth 4^L tiles of level 0 to rebuild, so its pages are given
+ * L + 1 sweeps of credit rather than one. Pinned pages are never evicted; if every
+ * page is pinned the pool grows past the budget rather than block, and shrinks back
+ * once they are unpinned.
+ */
+class TextureCache
+{
+
+public:
+	static const int TILE_SHIFT = 6; // Tiles of 64x64 texels
+	static const int TILE_SIZE = 1 << TILE_SHIFT;
+	static const int TILE_BYTES = TILE_SIZE * TILE_SIZE * 4; // BGRX texels, rows from the bottom
+
+	/**
+	 * Fills 'texels' with tile (tx, ty) of mip level 0. Texels outside the texture
+	 * may be left undefined.
+	 */
+	typedef std::function<void(int tx, int ty, unsigned char* texels)> TileLoader;
+
+private:
+	static const int MAX_TEXTURES = 1024;
+	static const uint64_t EMPTY = ~0ull; // Key of a free page
+	static const uint64_t BUSY = ~0ull - 1; // Key of a page being evicted or loaded
+
+	struct Page
+	{
+		std::atomic<uint64_t> key{EMPTY}; // Texture, level and tile held by the page
+		std::atomic<int> pins{0};
+		std::atomic<int> credit{0}; // Sweeps the page is spared for since its last hit
+		std::unique_ptr<unsigned char[]> texels;
+	};
+
+	struct Level
+	{
+		int wid, hgt, tilesX, tilesY;
+		std::unique_ptr<std::atomic<Page*>[]> slots; // Page holding each tile, nullptr if not resident
+	};
+
+	struct Texture
+	{
+		TileLoader loader;
+		std::vector<Level> levels;
+	};
+
+	std::atomic<Texture*> textures[MAX_TEXTURES] = {};
+	std::vector<std::unique_ptr<Page>> pages;
+	std::vector<Page*> released; // Pages whose texels were freed to fit the budget
+	size_t resident = 0; // Pages holding texels
+	size_t budget;
+	int hand = 0; // Position of the eviction sweep
+	std::recursive_mutex missLock; // Loading a coarse tile loads the tiles below it
+	std::atomic<long long> lookups{0}; // Counted per thread and added once per task
+	std::atomic<long long> misses{0};
+	std::atomic<long long> evictions{0};
+
+	static uint64_t makeKey(int texture, int level, int tile);
+	std::atomic<Page*>& slot(uint64_t key);
+	Page* pin(int texture, int level, int tx, int ty);
+	void unpin(Page* page);
+	Page* acquire(int texture, int level, int tx, int ty, bool& missed);
+	void count(bool missed);
+	static const unsigned char* texelOf(const Page* page, int x, int y);
+	Page* load(int texture, int level, int tx, int ty);
+	Page* evict();
+	Page* freePage();
+	void trim();
+	size_t capacity();
+	void downsample(int texture, int level, int tx, int ty, unsigned char* texels);
+
+public:
+	TextureCache(size_t budgetBytes = 256u << 20) : budget(budgetBytes) {}
+
+	~TextureCache();
+
+	/**
+	 * Registers a texture of wid x hgt texels (with all its mip levels, down to a
+	 * single texel) whose level 0 tiles come from 'loader'. Returns its id, or -1 if
+	 * the cache holds too many textures.
+	 */
+	int addTexture(int wid, int hgt, const TileLoader& loader);
+
+	/**
+	 * Frees the tiles and the id of a texture. It must no longer be sampled.
+	 */
+	void removeTexture(int texture);
+
+	/**
+	 * Copies texel (x, y) of mip level 'level' of a texture into 'bgrx'.
+	 */
+	void texel(int texture, int level, int x, int y, unsigned char* bgrx);
+
+	/**
+	 * Copies the 2x2 texels (xs[k & 1], ys[k >> 1]) of mip level 'level' into
+	 * 'bgrx[k]', as for a bilinear lookup. Each tile they fall into is pinned once,
+	 * and the call counts as one lookup.
+	 */
+	void texels(int texture, int level, const int xs[2], const int ys[2], unsigned char bgrx[4][4]);
+
+	void setBudget(size_t budgetBytes);
+
+	size_t getBudget();
+
+	size_t getResidentBytes();
+
+	/**
+	 * Lookups served by resident tiles. Call from the thread that started the
+	 * render, once its parallel tasks have returned.
+	 */
+	long long getHits();
+
+	long long getMisses();
+
+	long long getEvictions();
+
+	void resetStatistics();
+
+};
+
+#endif //!H_TEXCACHE
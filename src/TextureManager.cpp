@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "TextureManager.h"
+
+
+TextureHandle TextureManager::load(const std::string& filename, TextureBMP::Layout layout)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	std::weak_ptr<TextureBMP>& entry = textures[std::make_pair(filename, (int)layout)];
+	TextureHandle texture = entry.lock();
+	if (texture) return texture;
+
+	for (auto it = textures.begin(); it != textures.end(); ) // Forget the textures freed since
+	{
+		if (it->second.expired() && &it->second != &entry) it = textures.erase(it);
+		else ++it;
+	}
+	texture = std::make_shared<TextureBMP>(filename.c_str(), layout, cache);
+	loads++;
+	if (texture->getWidth() > 0) entry = texture;
+	return texture;
+}
+
+int TextureManager::getTextureCount()
+{
+	std::lock_guard<std::mutex> guard(lock);
+	int count = 0;
+	for (auto& entry : textures)
+	{
+		if (!entry.second.expired()) count++;
+	}
+	return count;
+}
+
+int TextureManager::getLoadCount()
+{
+	std::lock_guard<std::mutex> guard(lock);
+	return loads;
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#ifndef H_TEXMANAGER
+#define H_TEXMANAGER
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "TextureBMP.h"
+
+typedef std::shared_ptr<TextureBMP> TextureHandle;
+
+/**
+ * Loads each texture file once and hands out reference-counted handles to it, which
+ * objects hold as their material texture. A texture is freed with its last handle;
+ * the manager only keeps weak references, so textures no longer used by any object
+ * do not stay loaded, and loading a file that is still in use (e.g. by many objects,
+ * or by a scene being reloaded) returns the texture already in memory.
+ */
+class TextureManager
+{
+
+private:
+	TextureCache* cache; // Source of the texels of streamed textures
+	std::map<std::pair<std::string, int>, std::weak_ptr<TextureBMP>> textures; // By file name and layout
+	std::mutex lock;
+	int loads = 0;
+
+public:
+	TextureManager(TextureCache* cache = nullptr) : cache(cache) {}
+
+	/**
+	 * Returns a handle to the texture in 'filename' with the given layout, loading
+	 * it if it is not already loaded. Files that fail to load give an empty texture,
+	 * which samples as black, and are tried again by the next call.
+	 */
+	TextureHandle load(const std::string& filename, TextureBMP::Layout layout = TextureBMP::ROW_MAJOR);
+
+	/**
+	 * Number of textures in use.
+	 */
+	int getTextureCount();
+
+	/**
+	 * Number of files read so far; calls served by a texture in use are not counted.
+	 */
+	int getLoadCount();
+
+};
+
+#endif //!H_TEXMANAGER
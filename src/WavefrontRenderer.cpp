@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "WavefrontRenderer.h"
+#include "Parallel.h"
+#include <algorithm>
+
+const int MAX_STEPS = 5; // Same recursion limit as Scene::trace()
+const int CHUNK_SIZE = 256; // Queued rays handed to a thread at a time
+
+namespace
+{
+	// Index (0-7) of the octant containing the direction 'dir'.
+	int octant(glm::vec3 dir)
+	{
+		return (dir.x < 0 ? 1 : 0) | (dir.y < 0 ? 2 : 0) | (dir.z < 0 ? 4 : 0);
+	}
+}
+
+/**
+* Finds the closest point of intersection of every ray in the queue, in parallel.
+*/
+void WavefrontRenderer::extend()
+{
+	int size = queue.size();
+	parallelFor((size + CHUNK_SIZE - 1) / CHUNK_SIZE, [&](int c) {
+		for (int q = c * CHUNK_SIZE; q < std::min(size, (c + 1) * CHUNK_SIZE); q++)
+		{
+			queue[q].ray.closestPt(scene.objects);
+		}
+	});
+	scene.countRay(queue.size());
+}
+
+/**
+* Bins the queue by the object hit and then by direction octant (counting sort).
+* Rays that missed every object are left out.
+*/
+void WavefrontRenderer::sortQueue()
+{
+	int numBins = scene.objects.size() * 8;
+	std::vector<int> start(numBins + 1, 0);
+	for (QueuedRay& qr : queue)
+	{
+		if (qr.ray.index >= 0) start[qr.ray.index * 8 + octant(qr.ray.dir) + 1]++;
+	}
+	for (int b = 0; b < numBins; b++) start[b + 1] += start[b];
+	order.resize(start[numBins]);
+	for (size_t q = 0; q < queue.size(); q++)
+	{
+		const Ray& ray = queue[q].ray;
+		if (ray.index >= 0) order[start[ray.index * 8 + octant(ray.dir)]++] = q;
+	}
+}
+
+/**
+* Returns the light reflected at the hit of a queued ray towards its pixel and adds
+* the reflection and refraction rays to 'spawned', following the same rules as
+* Scene::trace().
+*/
+glm::vec3 WavefrontRenderer::shade(QueuedRay& qr, std::vector<QueuedRay>& spawned)
+{
+	Ray& ray = qr.ray;
+
+	if (qr.inside >= 0) {
+		// Leaving a refractive object: bend the ray out of it without shading
+		SceneObject* obj = scene.objects[qr.inside];
+		glm::vec3 m = obj->normal(ray.hit);
+		glm::vec3 h = glm::refract(ray.dir, -m, obj->getRefractiveIndex());
+		QueuedRay out;
+		out.ray = Ray(ray.hit, h);
+		out.ray.refractDifferentials(ray, obj, -m, obj->getRefractiveIndex());
+		out.weight = qr.weight;
+		out.pixel = qr.pixel;
+		out.step = qr.step;
+		spawned.push_back(out);
+		return glm::vec3(0);
+	}
+
+	SceneObject* obj = scene.objects[ray.index];
+	glm::vec3 normalVec = obj->normal(ray.hit);
+	glm::vec3 col = scene.surfaceColor(ray, scene.textureCoords(ray.index, ray.hit), normalVec);
+	float ao = scene.ambientOcclusion(ray.hit, glm::dot(normalVec, ray.dir) > 0 ? -normalVec : normalVec,
+		scene.aoSamples);
+	glm::vec3 color = ao * obj->ambient(col) + scene.directLighting(obj, col, ray.hit, -ray.dir, normalVec);
+	color += scene.caustics(col, ray.hit, normalVec);
+	color = scene.fog(color, ray.hit);
+
+	bool recurse = qr.step < MAX_STEPS;
+	float transmitted = (obj->isTransparent() && recurse) ? 1 - obj->getTransparencyCoeff() : 1;
+
+	if (obj->isReflective() && recurse) {
+		QueuedRay refl;
+		refl.ray = Ray(ray.hit, glm::reflect(ray.dir, normalVec));
+		refl.ray.reflectDifferentials(ray, obj, normalVec);
+		refl.weight = qr.weight * (obj->getReflectionCoeff() * transmitted); // Transparency also dims the reflection
+		refl.pixel = qr.pixel;
+		refl.step = qr.step + 1;
+		spawned.push_back(refl);
+	}
+
+	if (obj->isRefractive() && recurse) {
+		float eta = 1 / obj->getRefractiveIndex();
+		QueuedRay refr;
+		refr.ray = Ray(ray.hit, glm::refract(ray.dir, normalVec, eta));
+		refr.ray.refractDifferentials(ray, obj, normalVec, eta);
+		refr.weight = qr.weight * obj->getRefractionCoeff();
+		refr.pixel = qr.pixel;
+		refr.step = qr.step + 1;
+		refr.inside = ray.index;
+		spawned.push_back(refr);
+	}
+	return qr.weight * transmitted * color;
+}
+
+/**
+* Renders the scene into 'frame' (row major, starting from the bottom left pixel)
+* and the AOVs enabled in 'aovs', if given.
+*/
+void WavefrontRenderer::render(std::vector<glm::vec3>& frame, FrameBuffer* aovs)
+{
+	int n = camera.getNumDiv();
+	frame.assign(n * n, glm::vec3(0)); // Background colour = (0,0,0)
+
+	queue.assign(n * n, QueuedRay());
+	parallelFor(n, [&](int j) {
+		for (int i = 0; i < n; i++)
+		{
+			queue[j * n + i].ray = camera.primaryRay(i, j);
+			queue[j * n + i].pixel = j * n + i;
+		}
+	});
+
+	bool primary = true;
+	while (!queue.empty())
+	{
+		extend();
+		if (primary && aovs != nullptr) {
+			parallelFor(n, [&](int j) {
+				for (int q = j * n; q < (j + 1) * n; q++) aovs->writeHit(queue[q].pixel, scene, queue[q].ray);
+			});
+		}
+		primary = false;
+		sortQueue();
+
+		// Chunks of the sorted queue are shaded in parallel. The rays of one pixel
+		// may be in different chunks, so the light is added to the frame afterwards,
+		// and spawned rays are queued in chunk order, as a serial pass would.
+		int chunks = (order.size() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+		if (spawned.size() < (size_t)chunks) spawned.resize(chunks);
+		light.resize(order.size());
+		parallelFor(chunks, [&](int c) {
+			spawned[c].clear();
+			for (int k = c * CHUNK_SIZE; k < std::min((int)order.size(), (c + 1) * CHUNK_SIZE); k++)
+			{
+				light[k] = shade(queue[order[k]], spawned[c]);
+			}
+		});
+		for (size_t k = 0; k < order.size(); k++) frame[queue[order[k]].pixel] += light[k];
+		next.clear();
+		for (int c = 0; c < chunks; c++) next.insert(next.end(), spawned[c].begin(), spawned[c].end());
+		queue.swap(next);
+	}
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2022 Jack Brokenshire.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#ifndef H_WAVEFRONT
+#define H_WAVEFRONT
+#include <glm/glm.hpp>
+#include <vector>
+#include "Scene.h"
+#include "Camera.h"
+#include "FrameBuffer.h"
+
+/**
+ * Renders the scene one bounce generation at a time instead of recursing per pixel.
+ * All rays of a generation are kept in a flat queue and intersected with the scene
+ * together; the hits are then binned by object (material) and ray direction octant
+ * before shading, so rays that run the same shading code in similar directions are
+ * processed together. Shading spawns the reflection and refraction rays of the next
+ * generation, each carrying the weight with which it adds to its pixel.
+ */
+class WavefrontRenderer
+{
+
+private:
+	struct QueuedRay
+	{
+		Ray ray;
+		glm::vec3 weight = glm::vec3(1); // Scale applied to the light gathered by the ray
+		int pixel = 0; // Pixel the ray contributes to
+		int step = 1; // Recursion depth, as used by Scene::trace()
+		int inside = -1; // Object the ray travels through (refraction), or -1
+	};
+
+	Scene& scene;
+	Camera& camera;
+	std::vector<QueuedRay> queue; // Rays of the current generation
+	std::vector<QueuedRay> next; // Rays spawned for the next generation
+	std::vector<int> order; // Queue indices binned by object and direction octant
+	std::vector<glm::vec3> light; // Light reflected towards the pixel of each ray in 'order'
+	std::vector<std::vector<QueuedRay>> spawned; // Rays spawned by each chunk of 'order'
+
+	void extend();
+	void sortQueue();
+	glm::vec3 shade(QueuedRay& qr, std::vector<QueuedRay>& spawned);
+
+public:
+	WavefrontRenderer(Scene& s, Camera& c) : scene(s), camera(c) {}
+
+	void render(std::vector<glm::vec3>& frame, FrameBuffer* aovs = nullptr);
+
+};
+
+#endif //!H_WAVEFRONT